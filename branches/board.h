@@ -15,6 +15,11 @@
 #include "sys_config.h"
 #include "typedef.h"
 
+#if HOST_BUILD
+/* the host tools, without the AVR headers and the assembly. */
+#include "host_board.h"
+#else
+
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
@@ -80,6 +85,8 @@ asm volatile ( \
 
 
 
+#endif	/* #if HOST_BUILD */
+
 #endif
 
 
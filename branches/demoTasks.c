@@ -11,12 +11,14 @@
 /* === INCLUDES ============================================================ */
 #include "demoTasks.h"
 #include "usart.h"
+#include "ipc.h"
 #include "kdebug.h"
 #include "avr/delay.h"
 #include "mem_SFL.h"
 #include "multithreading_sched.h"
 #include "evt_driven_sched.h"
 #include "mem_reactive_SF.h"
+#include "mem_arena.h"
 
 /* === TYPES =============================================================== */
 
@@ -45,6 +47,8 @@
 /* === GLOBALS ============================================================= */
 /* software timer used by the tasks. */
 timer_t tskTimer, rtTimer1, rtTimer2, rtTimer3;
+/* send completion of the sensing packet. */
+ipc_txDone_t sensingTxDone;
 /* Thread TCB for the RT tasks. */
 thrd_tcb_t *rtTskThrd1 = NULL, *rtTskThrd2 = NULL, *rtTskThrd3 = NULL;
 
@@ -66,12 +70,20 @@ thrd_tcb_t *rtTskThrd1 = NULL, *rtTskThrd2 = NULL, *rtTskThrd3 = NULL;
  * 1). to keep high concurrency-intensive in the event-driven scheduling system. 
  * 2). to improve the software reliability (for roll-back recovery). 
  *
+ * With MEM_ARENA, the packet is kept in an arena from its creation to the end of the sending, 
+ * and it takes no memory while the node is asleep.
  */
 uint8_t
 dataCollect_Task(void)
 {
 	static uint8_t tsk_state = SENSING_TASK_INIT, pktRtrsCnt;
-	static sensingPkt_t sensingPkt;		/* packet to be sent. */
+	#if MEM_ARENA
+	static mem_arena_t pktArena;
+	static sensingPkt_t *sensingPkt;	/* packet to be sent. */
+	#else
+	static sensingPkt_t pktBuf;
+	static sensingPkt_t *sensingPkt = &pktBuf;	/* packet to be sent. */
+	#endif
 
 	/* init operation for this task. */
 	if(tsk_state == SENSING_TASK_INIT)
@@ -86,8 +98,21 @@ dataCollect_Task(void)
 	   Split operation is done in this handler before sending the frame out. */
 	if(tsk_state == SENSING_TASK_FRAME_CREATION)
 	{
+		#if MEM_ARENA
+		/* no memory for the packet, try again in the next working period. */
+		if(arena_begin(&pktArena, sizeof(sensingPkt_t)) != 0)
+		{
+			tskTimer.callback = sensingTskRestart;
+			tskTimer.interval = 60000;	/* 1 minutes. */
+			tskTimer.mode = TIMER_ONE_SHOT_MODE;
+			startTimer(&tskTimer);
+			return 0;
+		}
+		sensingPkt = arena_alloc(&pktArena, sizeof(sensingPkt_t));
+		#endif
+		
 		/* sample the sensing data, and fill them into the sensing packet. */
-		sensingDataSampling(sensingPkt);
+		sensingDataSampling(*sensingPkt);
 		
 		/* Set next task state (FRAME_SENDING), and then yield the processor control.
 		   yield the CPU control here because the execution time of a task cannot be too long in event-driven system. */
@@ -98,14 +123,34 @@ dataCollect_Task(void)
 	}	
 
 	/* send out the sensing data packet "sensingPkt" through the wireless TX module.
-	   Then, set a timer to wait the ACK for 4 seconds,
-	   if not received, the sensing packet will be retransmitted. */
+	   This task is posted again once the packet has left the radio. */
 	if(tsk_state == SENSING_TASK_FRAME_SENDING)
 	{
 		/* send packet out */
-		MIROS_send(WIRELESS_TX_ID, sensingPkt, sizeof(sensingPkt), 0);
+		sensingTxDone.cb = NULL;
+		sensingTxDone.tskID = dataCollect_Task_ID;
+		tsk_state = SENSING_TASK_FRAME_SENT;
+		if(send_async(WIRELESS_TX_ID, sensingPkt, sizeof(sensingPkt_t), 0, IPC_PRIO_NORMAL, &sensingTxDone) != 0)
+		{
+			sensingTxDone.status = IPC_TX_FAILED;
+			taskPost(dataCollect_Task_ID);
+		}
+		
+		return 0;
+	}
+	
+	/* The packet has left the radio, set a timer to wait the ACK for 4 seconds,
+	   if not received, the sensing packet will be retransmitted. */
+	if(tsk_state == SENSING_TASK_FRAME_SENT)
+	{
+		if(sensingTxDone.status != IPC_TX_OK)
+		{
+			tsk_state = SENSING_TASK_RETRANSMISSION;
+			taskPost(dataCollect_Task_ID);
+			return 0;
+		}
 		
-		/* start a timer to wait for the ACK. */
+		/* start a timer to wait for the ACK, from the TX-done instant. */
 		tskTimer.callback = sensingTskAckRslt;
 		tskTimer.interval = 4000;	/* 4 seconds. */
 		tskTimer.mode = TIMER_ONE_SHOT_MODE;
@@ -120,6 +165,11 @@ dataCollect_Task(void)
 		/* stop the ACK timer. */
 		stopTimer(&tskTimer);
 		
+		/* the packet has been acknowledged, give its memory back. */
+		#if MEM_ARENA
+		arena_end(&pktArena);
+		#endif
+		
 		/* set next working state, to sample the data again. */
 		tsk_state = SENSING_TASK_FRAME_CREATION;
 		
@@ -149,6 +199,9 @@ dataCollect_Task(void)
 		{
 			/* retransmission maximum times, still failed,
 				send an information through the USART to notify this. */
+			#if MEM_ARENA
+			arena_end(&pktArena);
+			#endif
 			send(USART_ID, "SEND_FAILED!\n", 15, 0);
 			return 1;
 		}		
@@ -163,12 +216,18 @@ dataCollect_Task(void)
  *
  * Send a command from the PC by the USART port. 
  * Once the command is received, this task will become active and perform a memory allocation. 
+ * With MEM_ARENA, the memory of this invocation is taken from an arena, and given back at once when the task ends.
  */
 uint8_t
 memAllocEval_Task(void)
 {
 	uint8_t t;
+	#if MEM_ARENA
+	mem_arena_t arena;
+	uint8_t *mem = NULL;
+	#else
 	uint16_t *mem = NULL;
+	#endif
 	uint8_t schedCmd[4] = {0xAD, evt_sched_debugID, nonRT_tskID, 0xFF};
 	
 	/* check whether task ID is correct. */
@@ -179,7 +238,12 @@ memAllocEval_Task(void)
 	}
 	
 	/* allocate the memory */
+	#if MEM_ARENA
+	if(arena_begin(&arena, NON_RT_TASK_MEM) == 0)
+		mem = arena_alloc(&arena, NON_RT_TASK_MEM);
+	#else
 	mem = mem_alloc(NON_RT_TASK_MEM);
+	#endif
 	memAllocLstUpdate();
 	
 	/* computation time of this non-RT task is NON_RT_TASK_TIME1. */
@@ -194,7 +258,11 @@ memAllocEval_Task(void)
 	/* release the allocated memory */
 	if(mem != NULL)
 	{
+		#if MEM_ARENA
+		arena_end(&arena);
+		#else
 		mem_free(mem);
+		#endif
 		memAllocLstUpdate();
 	}
 }
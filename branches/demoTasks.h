@@ -24,6 +24,7 @@ typedef enum
 	SENSING_TASK_INIT,
 	SENSING_TASK_FRAME_CREATION,
 	SENSING_TASK_FRAME_SENDING,
+	SENSING_TASK_FRAME_SENT,
 	SENSING_TASK_ACK_RECEPTION,
 	SENSING_TASK_ACK_NO_SUCCESS,
 	SENSING_TASK_RETRANSMISSION
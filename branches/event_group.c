@@ -0,0 +1,194 @@
+/**
+ * @file event_group.c
+ *
+ * @brief  event flag group to synchronize the threads with the events.
+ *
+ *			A thread can wait for any or all of a set of flags in the group.
+ *			Setting the flags wakes up, in a single pass, every waiting thread whose condition is satisfied,
+ *			thus one ISR can release several RT threads with only one thread dispatch.
+ *
+ * @author	  Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include "evt_driven_sched.h"
+#include "event_group.h"
+#include "semaphore.h"
+#include "kernel.h"
+#include "multithreading_sched.h"
+#include "kdebug.h"
+
+#if	RT_SUPPORT
+
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+
+
+/* === GLOBALS ============================================================= */
+
+
+/* === PROTOTYPES ========================================================== */
+static bool evg_satisfied(evg_flags_t flags, evg_flags_t mask, uint8_t mode);
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Function to initialize the event group.
+ * \param evg		Pointer to an event group structure.
+ */
+void 
+evg_init(event_group_t *evg)
+{
+	evg->flags = 0;
+	evg->evgQ_hdr = NULL;
+}
+
+/** 
+ * @brief  Set flags of the event group, and wake up the satisfied threads.
+ * \param evg		The event group.
+ * \param flags		Flags to be set.
+ * \param action	Whether force the thread switch if any thread is woken up.
+ *
+ * All the waiting threads are checked against the same flag value in a single pass,
+ * the flags requested to be cleared by the woken threads are cleared after this pass.
+ * It can be called from the ISR.
+ */
+uint8_t
+evg_set(event_group_t *evg, evg_flags_t flags, uint8_t action)
+{
+	HAS_CRITICAL_SECTION;
+	thrd_tcb_t *thrd, *next;
+	evg_flags_t clr = 0;
+	uint8_t wakeup = 0;
+	
+	ENTER_CRITICAL_SECTION;
+	evg->flags |= flags;
+	
+	/* check every thread waiting on this event group. */
+	for(thrd = evg->evgQ_hdr; thrd != NULL; thrd = next)
+	{
+		/* get next one before this thread is deleted from the queue. */
+		next = thrd->semQ_next;
+		
+		if(evg_satisfied(evg->flags, (evg_flags_t)thrd->wait_arg, thrd->wait_opt))
+		{
+			/* the flags to be cleared after this pass. */
+			if(thrd->wait_opt & EVG_OPT_CLEAR)
+				clr |= thrd->wait_arg;
+			/* return the flags that satisfied this thread. */
+			thrd->wait_arg = evg->flags & thrd->wait_arg;
+			/* delete from the event group queue, set it to "ACTIVE". */
+			thrd_wait_done(thrd, 0);
+			wakeup = 1;
+		}
+	}
+	evg->flags &= ~clr;
+	LEAVE_CRITICAL_SECTION;
+	
+	/* force the thread dispatcher now if it is required. */
+	if(wakeup && (action == DISPATCHER))
+		thread_dispatcher();
+	
+	return 0;
+}
+
+/** 
+ * @brief  Clear flags of the event group.
+ * \param evg		The event group.
+ * \param flags		Flags to be cleared.
+ */
+void
+evg_clear(event_group_t *evg, evg_flags_t flags)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	evg->flags &= ~flags;
+	LEAVE_CRITICAL_SECTION;
+}
+
+/** 
+ * @brief  Get current flags of the event group.
+ * \param evg		The event group.
+ */
+evg_flags_t
+evg_get(event_group_t *evg)
+{
+	return evg->flags;
+}
+
+/** 
+ * @brief Wait for the flags of an event group.
+ * \param evg		The event group.
+ * \param mask		Flags to wait for.
+ * \param mode		EVG_WAIT_ANY or EVG_WAIT_ALL.
+ * \param clear		If true, clear the flags in "mask" once the condition is satisfied.
+ * \param timeout	Maximum waiting time in ms, 0 to not wait, or WAIT_FOREVER.
+ * \param rcvd		If not NULL, return the flags in "mask" that were set.
+ * \return			0 if the condition is satisfied, TIMEOUT if not satisfied in time.
+ */
+uint8_t
+evg_wait(event_group_t *evg, evg_flags_t mask, uint8_t mode, uint8_t clear, uint16_t timeout, evg_flags_t *rcvd)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	/* condition is satisfied already. */
+	if(evg_satisfied(evg->flags, mask, mode))
+	{
+		if(rcvd != NULL)
+			*rcvd = evg->flags & mask;
+		if(clear)
+			evg->flags &= ~mask;
+		LEAVE_CRITICAL_SECTION;
+		return 0;
+	}
+	
+	/* not satisfied, and not allowed to wait. */
+	if(timeout == 0)
+	{
+		if(rcvd != NULL)
+			*rcvd = evg->flags & mask;
+		LEAVE_CRITICAL_SECTION;
+		return TIMEOUT;
+	}
+	
+	/* record the condition, and then wait in the queue. */
+	curThrd->wait_arg = mask;
+	curThrd->wait_opt = mode | (clear ? EVG_OPT_CLEAR : 0);
+	thrd_wait_prep(&evg->evgQ_hdr, timeout);
+	LEAVE_CRITICAL_SECTION;
+	
+	/* call task dispatcher */
+	thread_dispatcher();
+	
+	/* active again: "wait_arg" has been updated by "evg_set", or timeout. */
+	if(rcvd != NULL)
+	{
+		if(curThrd->wait_rslt == 0)
+			*rcvd = (evg_flags_t)curThrd->wait_arg;
+		else
+			*rcvd = evg->flags & mask;
+	}
+	return curThrd->wait_rslt;
+}
+
+/** 
+ * @brief Check the waiting condition of a thread.
+ * \param flags		Current flags of the event group.
+ * \param mask		Flags waited for.
+ * \param mode		EVG_WAIT_ANY or EVG_WAIT_ALL, the clear option is ignored.
+ */
+static bool
+evg_satisfied(evg_flags_t flags, evg_flags_t mask, uint8_t mode)
+{
+	if((mode & ~EVG_OPT_CLEAR) == EVG_WAIT_ALL)
+		return ((flags & mask) == mask);
+	else
+		return ((flags & mask) != 0);
+}
+#endif	// RT_SUPPORT
@@ -0,0 +1,61 @@
+/**
+ * @file event_group.h
+ *
+ * @brief  header for event_group.c.
+ *
+ * @author	  Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _EVENT_GROUP_H_
+#define _EVENT_GROUP_H_
+
+/* === INCLUDES ============================================================ */
+#include "evt_driven_sched.h"
+#include "kernel.h"
+#include "semaphore.h"
+
+/* === MACROS ============================================================== */
+/* width of the event flags: 16 flags if set to 1, otherwise 8 flags. */
+#define EVG_FLAGS_16BIT		1
+
+/* wait option: clear the flags that satisfied the waiting thread. */
+#define EVG_OPT_CLEAR		0x80
+
+/* === TYPES =============================================================== */
+#if EVG_FLAGS_16BIT
+typedef uint16_t evg_flags_t;
+#else
+typedef uint8_t evg_flags_t;
+#endif
+
+/** @brief 
+  * wait condition of a thread on the event group. */
+typedef enum evg_mode
+{
+	EVG_WAIT_ANY,		/* any flag in the mask is set. */
+	EVG_WAIT_ALL		/* all the flags in the mask are set. */
+} evg_mode_t;
+
+/** @brief 
+  * Event group data structure */
+typedef struct {
+	evg_flags_t flags;
+	thrd_tcb_t* evgQ_hdr;	/* threads waiting for the flags. */
+} event_group_t;
+
+/* === GLOBALS ============================================================= */
+
+
+/* === PROTOTYPES ========================================================== */
+extern void evg_init(event_group_t *evg);
+extern uint8_t evg_set(event_group_t *evg, evg_flags_t flags, uint8_t action);
+extern void evg_clear(event_group_t *evg, evg_flags_t flags);
+extern evg_flags_t evg_get(event_group_t *evg);
+extern uint8_t evg_wait(event_group_t *evg, evg_flags_t mask, uint8_t mode, uint8_t clear, uint16_t timeout, evg_flags_t *rcvd);
+
+
+#endif
+
@@ -20,6 +20,8 @@
 #include "kdebug.h"
 #include "board.h"
 #include "demoTasks.h"
+#include "mem_reactive_SF.h"
+#include "mem_proactive_SF.h"
 
 /* === TYPES =============================================================== */
 
@@ -67,9 +69,18 @@ event_driven_scheduling(void)
 	uint16_t fb;
 	tsk_handler_t tsk_exec = NULL;
 
-	/* In case that no tasks are active, enter the idle status. */
+	/* In case that no tasks are active, enter the idle status. 
+	   Before that, the memory fragments are assembled step by step. */
 	if(task_flags == 0)
 	{
+		#if MEM_REACTIVE_SF
+		if(fragment_assemble_step(FRAG_STEP_BUDGET))
+			return;
+		#endif
+		#if MEM_PROACTIVE_SF && PROSF_DEFER_FREE
+		if(mem_compact_step(COMPACT_STEP_BUDGET))
+			return;
+		#endif
 		hardware_sleep();
 		return;
 	}
@@ -0,0 +1,20 @@
+/**
+ * @file delay.h
+ *
+ * @brief  busy-wait delays, for the host build.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _HOST_DELAY_H_
+#define _HOST_DELAY_H_
+
+/* === Macros =============================================================== */
+#define _delay_ms(ms)		((void)(ms))
+#define _delay_us(us)		((void)(us))
+
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * @file host_board.h
+ *
+ * @brief header related to the hardware, for the host build.
+ *	Included by board.h in place of the AVR part when HOST_BUILD is set by the host sys_config.h,
+ *	for the host tools (mem_replay_host.c, ipc_bench_host.c):
+ *	no AVR header and no assembly, the I/O registers are plain variables,
+ *	and the critical sections save and clear a software interrupt flag.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _HOST_BOARD_H_
+#define _HOST_BOARD_H_
+ 
+/* === Includes ============================================================= */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* === Macros =============================================================== */
+/* Macroses to accept memory I/O registers */
+#define MMIO_BYTE(mem_addr) (*(volatile uint8_t *)(mem_addr))
+#define MMIO_WORD(mem_addr) (*(volatile uint16_t *)(mem_addr))
+
+/* I/O ports used by the GPIO and the debugging, they are not connected to anything. */
+#define PORTB	hostIO[0]
+#define DDRB	hostIO[1]
+#define PINB	hostIO[2]
+#define PORTD	hostIO[3]
+#define DDRD	hostIO[4]
+#define PIND	hostIO[5]
+#define PORTE	hostIO[6]
+#define DDRE	hostIO[7]
+#define PINE	hostIO[8]
+#define PORTF	hostIO[9]
+#define DDRF	hostIO[10]
+#define PINF	hostIO[11]
+#define PORTG	hostIO[12]
+#define DDRG	hostIO[13]
+#define PING	hostIO[14]
+
+/* program memory is the data memory on the host. */
+#define PROGMEM
+#define pgm_read_byte(addr)	(*(const uint8_t *)(addr))
+
+
+/**
+ * @brief interrupt
+ */
+#define ENABLE_GLOBAL_INTERRUPTS         (hostSREG = 1)
+#define DISABLE_GLOBAL_INTERRUPTS        (hostSREG = 0)
+#define sei()							 ENABLE_GLOBAL_INTERRUPTS
+#define cli()							 DISABLE_GLOBAL_INTERRUPTS
+
+#define HAS_CRITICAL_SECTION       uint8_t _prev_
+#define ENTER_CRITICAL_SECTION	(_prev_ = hostSREG, hostSREG = 0)
+#define LEAVE_CRITICAL_SECTION	(hostSREG = _prev_)
+
+
+/**
+ * @brief put hardware to idle mode
+ */
+#define hardware_sleep()
+#define atomic_hardware_sleep()
+
+/* === Types ================================================================ */
+
+
+/* === GLOBALS ============================================================= */
+extern volatile uint8_t hostIO[16];
+extern volatile uint8_t hostSREG;
+
+
+/* === Prototypes =========================================================== */
+
+
+
+#endif
@@ -0,0 +1,20 @@
+/**
+ * @file host_heap.c
+ *
+ * @brief  Heap of the host build.
+ *	On the node, "_sys_data_end" is given by the link script at the end of the DATA/BSS sections,
+ *	and the heap runs from there to HEAP_EADDR. On the host, it is an array of HEAP_SIZE bytes.
+ *	It is kept out of the units including kernel.h, where the symbol is declared as one word.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include <stdint.h>
+#include "sys_config.h"
+
+/* === GLOBALS ============================================================= */
+/* aligned for the pointers kept in the chunk headers. */
+uint16_t _sys_data_end[HEAP_SIZE / sizeof(uint16_t)] __attribute__((aligned(8)));
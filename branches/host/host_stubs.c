@@ -0,0 +1,85 @@
+/**
+ * @file host_stubs.c
+ *
+ * @brief  Hardware and kernel services of the host build.
+ *	The host tools run the allocators and the IPC in one thread, without interrupts and without the debug board.
+ *	This unit gives the I/O registers and the interrupt flag used by host_board.h,
+ *	and the services referenced by os_start.c and the IPC that the tools never run.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+/* the host "timer_t" is renamed, the MIROS one is used. */
+#define timer_t host_timer_t
+#include <time.h>
+#undef timer_t
+#include "typedef.h"
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+#include "kdebug.h"
+#include "ipc.h"
+#include "usart.h"
+
+/* === GLOBALS ============================================================= */
+volatile uint8_t hostIO[16];
+/* global interrupt flag, set as on the node once the kernel is started. */
+volatile uint8_t hostSREG = 1;
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief No debug board on the host, the debug codes are dropped.
+ */
+void kDebug_init(void) {}
+void kDebug8bit(uint8_t val) { (void)val; }
+void kDebug16bit(uint16_t val) { (void)val; }
+void kDebug32bit(uint32_t val) { (void)val; }
+
+/**
+ * @brief No RT thread and no system task is run by the host tools.
+ */
+void start_RT_tasks(void) {}
+void dataCollect_Task(void) {}
+
+/**
+ * @brief The allocator replay is built without the IPC.
+ */
+#if !IPC_BENCH_HOST
+void netbuf_init(void) {}
+void ipc_init(void) {}
+#endif
+
+#if IPC_BENCH_HOST
+/* the USART port is registered by "ipc_init", the benchmark only sends to the loopback port. */
+ipc_sendQ_t usartSendQ;
+ipc_queue_t uasrtRecvQ;
+uint8_t usartSendString(void) { return 0; }
+uint8_t usartRecvString(void) { return 0; }
+
+/**
+ * @brief System time in ms, from the host clock.
+ */
+uint32_t
+GetSysTime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000ul + ts.tv_nsec / 1000000ul);
+}
+
+/**
+ * @brief No timer is fired and no task is run: the benchmark uses neither the coalescing nor the send completions.
+ *	The senders run in the common thread, which never blocks.
+ */
+int startTimer(timer_t *Timer) { (void)Timer; return 0; }
+int stopTimer(timer_t *Timer) { (void)Timer; return 0; }
+void taskPost(uint8_t task_ID) { (void)task_ID; }
+void thrd_wait_prep(thrd_tcb_t **waitQ, uint16_t timeout) { (void)waitQ; (void)timeout; }
+void thrd_wait_done(thrd_tcb_t *thrd, uint8_t rslt) { (void)thrd; (void)rslt; }
+void thread_dispatcher(void) {}
+#endif
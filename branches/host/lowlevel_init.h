@@ -0,0 +1,19 @@
+/**
+ * @file lowlevel_init.h
+ *
+ * @brief  low-level hardware init, for the host build.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _LOWLEVEL_INIT_H_
+#define _LOWLEVEL_INIT_H_
+
+/* === Prototypes =========================================================== */
+extern void lowlevel_init(void);
+
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ * @file sys_config.h
+ *
+ * @brief  system configuration, for the host build.
+ *	The allocator and the tool are selected on the compiler command line (see the Makefile),
+ *	the other options are those of the node.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _SYS_CONFIG_H_
+#define _SYS_CONFIG_H_
+
+/* === Macros =============================================================== */
+/* board.h takes the host part, see host_board.h. */
+#define HOST_BUILD		1
+
+#ifndef RT_SUPPORT
+#define RT_SUPPORT		1
+#endif
+#ifndef TIMER_ACV
+#define TIMER_ACV		1
+#endif
+#ifndef TIMER_RCV
+#define TIMER_RCV		0
+#endif
+/* no debug board on the host. */
+#define DEBUG_SUPPORT	0
+#define KDEBUG_DEMO		0
+#define TIMER_DEBUG		0
+
+/* the heap starts at "_sys_data_end", given by host_stubs.c on the host,
+   and has about the size of the node heap. */
+#ifndef HEAP_SIZE
+#define HEAP_SIZE		3000
+#endif
+#define HEAP_EADDR		((uintptr_t)&_sys_data_end + HEAP_SIZE)
+
+
+#endif
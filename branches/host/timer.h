@@ -0,0 +1,20 @@
+/**
+ * @file timer.h
+ *
+ * @brief  hardware timer, for the host build.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+/* === Macros =============================================================== */
+/* interval of the application timer in ms. */
+#define APPTIMERINTERVAL	10
+
+
+#endif
@@ -0,0 +1,28 @@
+/**
+ * @file typedef.h
+ *
+ * @brief  common types and macros, for the host build.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _TYPEDEF_H_
+#define _TYPEDEF_H_
+
+/* === Includes ============================================================= */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/* === Macros =============================================================== */
+/* C99 inline: a header definition is only used for inlining, a unit declaring the function "extern" gives its definition. */
+#define INLINE			inline
+#define __ALIGNED2
+#define ALIGN(x, a)		(((x) + ((a) - 1)) & ~((a) - 1))
+
+
+#endif
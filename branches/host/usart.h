@@ -0,0 +1,36 @@
+/**
+ * @file usart.h
+ *
+ * @brief  USART port, for the host build.
+ *	The port is registered by "ipc_init" as on the node, but nothing is sent out.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _USART_H_
+#define _USART_H_
+
+/* === Includes ============================================================= */
+#include "ipc.h"
+
+
+/* === Macros =============================================================== */
+#define USART_CHANNEL_1		1
+
+
+/* === GLOBALS ============================================================= */
+extern uint8_t usartSndStatus;
+extern ipc_sendQ_t usartSendQ;
+extern ipc_queue_t uasrtRecvQ;
+
+
+/* === Prototypes =========================================================== */
+extern void sendUsartByte(uint8_t ch, uint8_t b);
+extern uint8_t usartSendString(void);
+extern uint8_t usartRecvString(void);
+
+
+#endif
@@ -10,6 +10,7 @@
  */
 
 /* === INCLUDES ============================================================ */
+#include <string.h>
 #include "board.h"
 #include "timer_ACV.h"
 #include "lowlevel_init.h"
@@ -18,27 +19,312 @@
 #include "kdebug.h"
 #include "demoTasks.h"
 #include "ipc.h"
+#include "ipc_loopback.h"
 #include "mem_SFL.h"
 #include "mem_reactive_SF.h"
+#include "mem_proactive_SF.h"
+#include "mem_TLSF.h"
 
 /* === TYPES =============================================================== */
 
 
 /* === MACROS ============================================================== */
+/* reference of the frame message of a coalescing stage. */
+#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+#define IPC_FRAME_REF(coal)		((ipc_msgRef_t)&(coal)->frameSlot)
+#else
+#define IPC_FRAME_REF(coal)		(&(coal)->frameMsg)
+#endif
+
+/* update the counters of an IPC port. */
+#if IPC_STATS
+#define IPC_STATS_INC(id, cnt)	(IPC_handlers[id].stats.cnt++)
+#if TIMER_ACV
+#define IPC_STATS_NOW()			((uint16_t)GetSysTime())
+#else
+#define IPC_STATS_NOW()			0
+#endif
+#else
+#define IPC_STATS_INC(id, cnt)
+#endif
+
+/* the IPC port can be used. */
+#define IPC_PORT_VALID(id)		((uint8_t)(id) < IPC_PORT_MAX && IPC_handlers[id].ops != NULL)
 
 
 /* === GLOBALS ============================================================= */
-/* The initial order should match the order in the enum "ipcID_t".
-   This table can aslo be put into FLASH (by using modifier "PROGMEM"). */
-ipc_register_t IPC_handlers[] =
+/* IPC port table, indexed by the IPC ID, filled by "ipc_register_port". */
+ipc_register_t IPC_handlers[IPC_PORT_MAX];
+
+#if IPC_BENCH
+/* allocator calls of the IPC, counted by the benchmark. */
+uint32_t ipc_allocCalls;
+#endif
+
+/* operations of the built-in USART port. */
+static const ipc_ops_t usart_ops = 
 {
-	{&usartSndStatus, (ipcHandler_t)usartSendString, &usartSendQ, (ipcHandler_t)usartRecvString, &uasrtRecvQ},
+	(ipcHandler_t)usartSendString, (ipcHandler_t)usartRecvString, NULL, NULL
 };
 
 /* === PROTOTYPES ========================================================== */
-
+static ipc_msgRef_t ipc_sendQ_next(ipc_sendQ_t *sendQ);
+static void ipc_sendKick(ipcID_t id);
+static void ipc_sendRelease(ipcID_t id, ipc_msgRef_t msgQ, uint8_t status);
+static ipc_msgRef_t ipc_coalesce(ipc_sendQ_t *sendQ, ipc_msgRef_t msgQ);
+static void ipc_linger_cb(void *data);
+static uint8_t ipc_flow_admit(ipcID_t id, uint8_t prio);
+static void ipc_flow_release(ipcID_t id);
+static void ipc_flow_cancel(ipcID_t id);
+static uint8_t ipc_sendQ_len(ipc_sendQ_t *sendQ);
+#if IPC_STATS
+static void ipc_stats_tx(ipcID_t id, ipc_msgRef_t msgQ, uint8_t status);
+#endif
 
 /* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Register the built-in IPC ports.
+ */
+void
+ipc_init(void)
+{
+	ipc_register_port(USART_ID, &usart_ops, &usartSendQ, &uasrtRecvQ);
+	#if IPC_LOOPBACK
+	ipc_loopback_init(NULL);
+	#endif
+}
+
+/**
+ * @brief Register an IPC port.
+ * \param id		IPC ID of the port, less than IPC_PORT_MAX.
+ * \param ops		Operations of the port driver.
+ * \param sendQ	Sending queue of the port.
+ * \param recvQ	Receiving queue of the port.
+ * \return		0 if registered, PORT_UNREGISTERED if the ID is out of the table or already used.
+ *
+ * The queues are initialized here. After that, the port can be used by "send" and "recv".
+ */
+uint8_t
+ipc_register_port(ipcID_t id, const ipc_ops_t *ops, ipc_sendQ_t *sendQ, ipc_queue_t *recvQ)
+{
+	uint8_t c;
+	
+	if((uint8_t)id >= IPC_PORT_MAX || IPC_handlers[id].ops != NULL || ops == NULL)
+		return PORT_UNREGISTERED;
+	
+	for(c = 0; c < IPC_PRIO_NUM; c++)
+	{
+		sendQ->cls[c].head = sendQ->cls[c].tail = NULL;
+		sendQ->cls[c].len = 0;
+		sendQ->cls[c].bytes = 0;
+		sendQ->credit[c] = 0;
+	}
+	sendQ->txMsg = NULL;
+	sendQ->coal = NULL;
+	sendQ->flow.maxLen = IPC_QLEN_DEFAULT;
+	sendQ->flow.hwm = IPC_HWM_DEFAULT;
+	sendQ->flow.policy = IPC_POLICY_REJECT;
+	sendQ->flow.congested = 0;
+	sendQ->flow.reserved = 0;
+	sendQ->flow.timeout = WAIT_FOREVER;
+	sendQ->flow.notify = NULL;
+	sendQ->flow.blockQ = NULL;
+	recvQ->head = recvQ->tail = NULL;
+	recvQ->len = 0;
+	recvQ->bytes = 0;
+	
+	IPC_handlers[id].ipcSendQ = sendQ;
+	IPC_handlers[id].ipcRecvQ = recvQ;
+	IPC_handlers[id].status = IPC_FREE;
+	#if IPC_STATS
+	memset(&IPC_handlers[id].stats, 0, sizeof(ipc_stats_t));
+	#endif
+	IPC_handlers[id].ops = ops;
+	
+	return 0;
+}
+
+/**
+ * @brief Drop all the messages waiting on an IPC port.
+ * \param id   IPC unique ID.
+ * \return	   0 if flushed, PORT_UNREGISTERED if the port is not registered.
+ *
+ * The message being sent is aborted as well if the driver supports "flush",
+ * else it is sent out and released as usual.
+ */
+uint8_t
+ipc_flush(ipcID_t id)
+{
+	HAS_CRITICAL_SECTION;
+	ipc_sendQ_t *sendQ;
+	ipc_msgRef_t msgQ;
+	uint8_t c;
+	
+	if(!IPC_PORT_VALID(id))	return PORT_UNREGISTERED;
+	sendQ = IPC_handlers[id].ipcSendQ;
+	
+	ENTER_CRITICAL_SECTION;
+	/* drop the waiting messages. */
+	for(c = 0; c < IPC_PRIO_NUM; c++)
+	{
+		while((msgQ = ipc_dequeue(&sendQ->cls[c])) != NULL)
+			ipc_msgQ_done(msgQ, IPC_TX_FLUSHED);
+	}
+	ipc_flow_release(id);
+	if(sendQ->coal != NULL && sendQ->coal->lingering)
+	{
+		sendQ->coal->lingering = 0;
+		stopTimer(&sendQ->coal->lingerTimer);
+	}
+	/* abort the message being sent. */
+	if(IPC_handlers[id].status == IPC_BUSY && IPC_handlers[id].ops->flush != NULL)
+	{
+		IPC_handlers[id].ops->flush();
+		if(sendQ->txMsg != NULL)
+			ipc_sendRelease(id, sendQ->txMsg, IPC_TX_FLUSHED);
+		sendQ->txMsg = NULL;
+		IPC_handlers[id].status = IPC_FREE;
+	}
+	LEAVE_CRITICAL_SECTION;
+	
+	return 0;
+}
+
+/**
+ * @brief Set the flow control of an IPC port.
+ * \param id		IPC unique ID.
+ * \param maxLen	Max number of messages waiting to be sent, 0 for no limit.
+ * \param hwm		High-water mark for the backpressure notification, 0 for none.
+ * \param policy	Overflow policy, "ipc_policy_t".
+ * \param timeout	Blocking time in ms with IPC_POLICY_BLOCK, or WAIT_FOREVER.
+ * \param notify	Backpressure callback, NULL for none.
+ * \return		0 if set, PORT_UNREGISTERED if the port is not registered.
+ *
+ * A registered port is limited to IPC_QLEN_DEFAULT messages with IPC_POLICY_REJECT,
+ * thus a stalled port can not use up the memory shared with the rest of the kernel.
+ */
+uint8_t
+ipc_flow_init(ipcID_t id, uint8_t maxLen, uint8_t hwm, uint8_t policy, uint16_t timeout, ipc_backpressure_t notify)
+{
+	HAS_CRITICAL_SECTION;
+	ipc_flow_t *flow;
+	
+	if(!IPC_PORT_VALID(id))	return PORT_UNREGISTERED;
+	flow = &IPC_handlers[id].ipcSendQ->flow;
+	
+	ENTER_CRITICAL_SECTION;
+	flow->maxLen = maxLen;
+	flow->hwm = hwm;
+	flow->policy = policy;
+	flow->timeout = timeout;
+	flow->notify = notify;
+	LEAVE_CRITICAL_SECTION;
+	
+	return 0;
+}
+
+#if IPC_STATS
+/**
+ * @brief Get the counters of an IPC port.
+ * \param id		IPC unique ID.
+ * \param stats	Return the counters.
+ * \return		0, or PORT_UNREGISTERED if the port is not registered.
+ */
+uint8_t
+ipc_stats_get(ipcID_t id, ipc_stats_t *stats)
+{
+	HAS_CRITICAL_SECTION;
+	
+	if(!IPC_PORT_VALID(id))	return PORT_UNREGISTERED;
+	
+	ENTER_CRITICAL_SECTION;
+	*stats = IPC_handlers[id].stats;
+	LEAVE_CRITICAL_SECTION;
+	
+	return 0;
+}
+
+/**
+ * @brief Clear the counters of an IPC port.
+ * \param id		IPC unique ID.
+ */
+void
+ipc_stats_reset(ipcID_t id)
+{
+	HAS_CRITICAL_SECTION;
+	
+	if(!IPC_PORT_VALID(id))	return;
+	
+	ENTER_CRITICAL_SECTION;
+	memset(&IPC_handlers[id].stats, 0, sizeof(ipc_stats_t));
+	LEAVE_CRITICAL_SECTION;
+}
+
+/**
+ * @brief Send the counters of an IPC port to the debug board.
+ * \param id		IPC unique ID.
+ *
+ * Trace command: (0xAD: ipcStats_debugID: id: counters in the order of "ipc_stats_t", high byte first: 0xFF).
+ */
+void
+ipc_stats_dump(ipcID_t id)
+{
+	ipc_stats_t st;
+	
+	if(ipc_stats_get(id, &st) != 0)	return;
+	
+	/* send the header firstly */
+	kDebug8bit(0xAD);
+	kDebug8bit(ipcStats_debugID);
+	kDebug8bit(id);
+	/* send the body code */
+	kDebug16bit(st.txMsgs);
+	kDebug32bit(st.txBytes);
+	kDebug16bit(st.rxMsgs);
+	kDebug32bit(st.rxBytes);
+	kDebug16bit(st.allocFails);
+	kDebug16bit(st.drops);
+	kDebug8bit(st.peakDepth);
+	kDebug32bit(st.latency);
+	/* send the tail */
+	kDebug8bit(0xFF);
+}
+
+/**
+ * @brief Count a message which has left the IPC port.
+ * \param id		IPC unique ID.
+ * \param msgQ	The message.
+ * \param status	Result of the sending, "ipc_txStatus_t".
+ */
+static void
+ipc_stats_tx(ipcID_t id, ipc_msgRef_t msgQ, uint8_t status)
+{
+	ipc_stats_t *st = &IPC_handlers[id].stats;
+	
+	if(status != IPC_TX_OK)	return;
+	
+	st->txMsgs++;
+	st->txBytes += IPC_MSG(msgQ)->size;
+	/* 16-bit time, the difference is right across a wrap as long as the message has waited less than 65536 ms. */
+	st->latency += (uint16_t)(IPC_STATS_NOW() - IPC_MSG(msgQ)->tEnq);
+}
+#endif	/* #if IPC_STATS */
+
+/**
+ * @brief Get the driver statistics of an IPC port.
+ * \param id		IPC unique ID.
+ * \param stats	Driver specific statistics structure to be filled.
+ * \return		Return value of the driver, PORT_UNREGISTERED if the port has no statistics.
+ */
+uint8_t
+ipc_port_stats(ipcID_t id, void *stats)
+{
+	if(!IPC_PORT_VALID(id) || IPC_handlers[id].ops->stats == NULL)
+		return PORT_UNREGISTERED;
+	
+	return IPC_handlers[id].ops->stats(stats);
+}
+
 /**
  * @brief The unified IPC sending interface in the MIROS.
  * \param id   IPC ID, to indicate the IPC sending or receiving component.
@@ -54,58 +340,715 @@ ipc_register_t IPC_handlers[] =
 uint8_t
 send(ipcID_t id, void *msg, uint8_t size, uint16_t opt)
 {
-	ipc_msgQ_t *msgQ, **sendQ, *q;
-	uint8_t *ipcStatus;
+	ipc_msgRef_t msgQ;
+	uint8_t rslt;
+	
+	if(!IPC_PORT_VALID(id))	return PORT_UNREGISTERED;
+	
+	/* make room in the sending queue, or reject the message. */
+	rslt = ipc_flow_admit(id, IPC_PRIO_NORMAL);
+	if(rslt != 0)	return rslt;
 	
 	/* allocate a memory space for the IPC "ipc_msgQ_t" structure. */
 	msgQ = ipc_msgQ_alloc(msg, size, opt);
-	if(msgQ == NULL)	return MEM_ALLOC_ERROR;
+	if(msgQ == NULL)
+	{
+		ipc_flow_cancel(id);
+		IPC_STATS_INC(id, allocFails);
+		return MEM_ALLOC_ERROR;
+	}
+
+	return ipc_submit(id, msgQ);
+}
+
+/**
+ * @brief Send a message with a given priority class.
+ * \param id   IPC ID, to indicate the IPC sending component.
+ * \param msg  Message to be sent.
+ * \param size Message length.
+ * \param opt  Sending option, can be a pointer or a 16-bit word.
+ * \param prio Priority class, "ipc_prio_t".
+ *
+ * The message is sent before all the waiting messages of the lower classes.
+ */
+uint8_t
+send_prio(ipcID_t id, void *msg, uint8_t size, uint16_t opt, uint8_t prio)
+{
+	return send_async(id, msg, size, opt, prio, NULL);
+}
+
+/**
+ * @brief Send a message, and be notified once it has left the IPC port.
+ * \param id   IPC ID, to indicate the IPC sending component.
+ * \param msg  Message to be sent.
+ * \param size Message length.
+ * \param opt  Sending option, can be a pointer or a 16-bit word.
+ * \param prio Priority class, "ipc_prio_t".
+ * \param done Send completion, NULL for none.
+ * \return	   0 if queued, the error code otherwise, and then "done" is not used.
+ *
+ * "msg" must be kept by the sender until the completion, it can then be reused or released.
+ */
+uint8_t
+send_async(ipcID_t id, void *msg, uint8_t size, uint16_t opt, uint8_t prio, ipc_txDone_t *done)
+{
+	ipc_msgRef_t msgQ;
+	uint8_t rslt;
+	
+	if(!IPC_PORT_VALID(id))	return PORT_UNREGISTERED;
+	
+	/* make room in the sending queue, or reject the message. */
+	rslt = ipc_flow_admit(id, prio);
+	if(rslt != 0)	return rslt;
+	
+	/* allocate a memory space for the IPC "ipc_msgQ_t" structure. */
+	msgQ = ipc_msgQ_alloc(msg, size, opt);
+	if(msgQ == NULL)
+	{
+		ipc_flow_cancel(id);
+		IPC_STATS_INC(id, allocFails);
+		return MEM_ALLOC_ERROR;
+	}
+	IPC_MSG(msgQ)->prio = prio;
+	IPC_MSG(msgQ)->done = done;
+
+	return ipc_submit(id, msgQ);
+}
+
+/**
+ * @brief Send a message made of several fragments, without assembling them.
+ * \param id   IPC ID, to indicate the IPC sending component.
+ * \param iov  Fragments of the message, sent in order.
+ * \param n    Number of fragments.
+ * \param opt  Sending option, can be a pointer or a 16-bit word.
+ * \return	   0 if queued, MSG_SIZE_ERROR if the total length exceeds 255 bytes or a fragment is empty, 
+ *			   or the other error codes.
+ *
+ * The fragments and the "iov" array must be kept by the sender until the message has been sent out.
+ * E.g., a frame can be built from a header, a payload and a trailer kept in different places.
+ */
+uint8_t
+sendv(ipcID_t id, ipc_iovec_t *iov, uint8_t n, uint16_t opt)
+{
+	ipc_msgRef_t msgQ;
+	uint16_t size = 0;
+	uint8_t i, rslt;
+	
+	if(!IPC_PORT_VALID(id))	return PORT_UNREGISTERED;
+	
+	/* an empty fragment would be taken as the end of the message by "ipc_msg_frag". */
+	for(i = 0; i < n; i++)
+	{
+		if(iov[i].len == 0)	return MSG_SIZE_ERROR;
+		size += iov[i].len;
+	}
+	if(size > 0xFF)	return MSG_SIZE_ERROR;
+	
+	/* make room in the sending queue, or reject the message. */
+	rslt = ipc_flow_admit(id, IPC_PRIO_NORMAL);
+	if(rslt != 0)	return rslt;
+	
+	/* allocate a memory space for the IPC "ipc_msgQ_t" structure, "data" refers to the fragments. */
+	msgQ = ipc_msgQ_alloc(iov, (uint8_t)size, opt);
+	if(msgQ == NULL)
+	{
+		ipc_flow_cancel(id);
+		IPC_STATS_INC(id, allocFails);
+		return MEM_ALLOC_ERROR;
+	}
+	IPC_MSG(msgQ)->iovcnt = n;
+
+	return ipc_submit(id, msgQ);
+}
+
+/**
+ * @brief Send a network buffer without copying it.
+ * \param id   IPC ID, to indicate the IPC sending component.
+ * \param buf  Network buffer to be sent, "buf->len" bytes.
+ * \param opt  Sending option, can be a pointer or a 16-bit word.
+ * \param prio Priority class, "ipc_prio_t".
+ *
+ * The message takes one reference to the buffer, and releases it after the message has been sent out.
+ * The caller keeps its own reference, thus the same buffer can be sent to several IPC ports, 
+ * and then released by the caller with "netbuf_free".
+ */
+uint8_t
+send_buf(ipcID_t id, netbuf_t *buf, uint16_t opt, uint8_t prio)
+{
+	ipc_msgRef_t msgQ;
+	uint8_t rslt;
+	
+	if(!IPC_PORT_VALID(id))	return PORT_UNREGISTERED;
+	
+	/* make room in the sending queue, or reject the message. */
+	rslt = ipc_flow_admit(id, prio);
+	if(rslt != 0)	return rslt;
+	
+	/* allocate a memory space for the IPC "ipc_msgQ_t" structure. */
+	msgQ = ipc_msgQ_alloc(buf->data, buf->len, opt);
+	if(msgQ == NULL)
+	{
+		ipc_flow_cancel(id);
+		IPC_STATS_INC(id, allocFails);
+		return MEM_ALLOC_ERROR;
+	}
+	
+	/* the message holds a reference to the buffer. */
+	netbuf_ref(buf);
+	IPC_MSG(msgQ)->buf = buf;
+	IPC_MSG(msgQ)->prio = prio;
 
-	/* get the corresponding IPC sending queue. Read from the AVR FLASH. */
+	return ipc_submit(id, msgQ);
+}
+
+/**
+ * @brief Put an allocated message into the IPC sending queue.
+ * \param id    IPC ID, to indicate the IPC sending component.
+ * \param msgQ  Message allocated by "ipc_msgQ_alloc".
+ *
+ * If the IPC port is free, send the message out. 
+ * If the IPC port is busy, the message will be sent by "ipc_sendNextMsg" after the previous ones.
+ * With coalescing, a small message on a free port lingers to be sent together with the following ones,
+ * until a frame can be filled up or the linger timer is fired. The high class never lingers.
+ */
+uint8_t
+ipc_submit(ipcID_t id, ipc_msgRef_t msgQ)
+{
+	HAS_CRITICAL_SECTION;
+	ipc_sendQ_t *sendQ;
+	ipc_coalesce_t *coal;
+	uint8_t prio;
+	
+	/* the message is kept by the caller if the port is not registered. */
+	if(!IPC_PORT_VALID(id))	return PORT_UNREGISTERED;
 	sendQ = IPC_handlers[id].ipcSendQ;
+	coal = sendQ->coal;
 
-	/* add this message to the IPC sending queue. */
-	if(*sendQ == NULL)
-		*sendQ = msgQ;
-	else
+	/* add this message to the tail of the queue of its priority class. */
+	if(IPC_MSG(msgQ)->prio >= IPC_PRIO_NUM)
+		IPC_MSG(msgQ)->prio = IPC_PRIO_LOW;
+	prio = IPC_MSG(msgQ)->prio;
+	#if IPC_STATS
+	IPC_MSG(msgQ)->tEnq = IPC_STATS_NOW();
+	#endif
+	/* the place reserved at the admission is taken by the message. */
+	ENTER_CRITICAL_SECTION;
+	if(sendQ->flow.reserved != 0)
+		sendQ->flow.reserved--;
+	ipc_enqueue(&sendQ->cls[prio], msgQ);
+	LEAVE_CRITICAL_SECTION;
+	#if IPC_STATS
+	if(ipc_sendQ_len(sendQ) > IPC_handlers[id].stats.peakDepth)
+		IPC_handlers[id].stats.peakDepth = ipc_sendQ_len(sendQ);
+	#endif
+	
+	/* notify the producer once the high-water mark is reached. */
+	if(sendQ->flow.hwm != 0 && !sendQ->flow.congested && ipc_sendQ_len(sendQ) >= sendQ->flow.hwm)
 	{
-		for(q = *sendQ; q->next != NULL; q = q->next);
-		q->next = msgQ;
+		sendQ->flow.congested = 1;
+		if(sendQ->flow.notify != NULL)
+			sendQ->flow.notify(id, 1);
 	}
 	
-	/* send the message out, and set this IPC status to be BUSY. */
-	ipcStatus = IPC_handlers[id].status;
-	*ipcStatus = IPC_BUSY;
-	IPC_handlers[id].send_handler();
+	if(coal != NULL && coal->linger != 0 && prio != IPC_PRIO_HIGH
+	   && IPC_MSG(msgQ)->size <= coal->small && sendQ->cls[prio].bytes < coal->mtu)
+	{
+		ENTER_CRITICAL_SECTION;
+		if(IPC_handlers[id].status != IPC_BUSY)
+		{
+			if(!coal->lingering)
+			{
+				coal->lingering = 1;
+				coal->lingerTimer.interval = coal->linger;
+				startTimer(&coal->lingerTimer);
+			}
+			LEAVE_CRITICAL_SECTION;
+			return 0;
+		}
+		LEAVE_CRITICAL_SECTION;
+	}
+	
+	/* if the IPC port is free, send the message out. */
+	ipc_sendKick(id);
 			
 	return 0;
 }
 
+/**
+ * @brief Start sending on an IPC port if it is not busy.
+ * \param id   IPC unique ID.
+ */
+static void
+ipc_sendKick(ipcID_t id)
+{
+	HAS_CRITICAL_SECTION;
+	ipc_sendQ_t *sendQ = IPC_handlers[id].ipcSendQ;
+	uint8_t *ipcStatus = &IPC_handlers[id].status;
+	
+	ENTER_CRITICAL_SECTION;
+	if(*ipcStatus == IPC_BUSY)
+	{
+		LEAVE_CRITICAL_SECTION;
+		return;
+	}
+	/* the waiting messages are sent now, no more lingering. */
+	if(sendQ->coal != NULL && sendQ->coal->lingering)
+	{
+		sendQ->coal->lingering = 0;
+		stopTimer(&sendQ->coal->lingerTimer);
+	}
+	sendQ->txMsg = ipc_coalesce(sendQ, ipc_sendQ_next(sendQ));
+	ipc_flow_release(id);
+	if(sendQ->txMsg == NULL)
+	{
+		*ipcStatus = IPC_FREE;
+		LEAVE_CRITICAL_SECTION;
+		return;
+	}
+	/* send the message out, and set this IPC status to be BUSY. */
+	*ipcStatus = IPC_BUSY;
+	LEAVE_CRITICAL_SECTION;
+	
+	IPC_handlers[id].ops->send();
+}
+
 /**
  * @brief Send next message in the IPC message queue.
  * \param id   IPC unique ID, all the IPC operations are done through this ID.
  *
  * If sending from a hardware port, an interruption will be generated after a message has been sent out.
- * Inside the ISR, this function will be called to send the next message.
+ * Inside the ISR, this function will be called to release the sent message and send the next message.
+ * The next message is taken from the highest non-empty priority class.
  */
 void
 ipc_sendNextMsg(ipcID_t id)
 {
-	ipc_msgQ_t *sendQ;
-	uint8_t *status;
+	ipc_sendComplete(id, IPC_TX_OK);
+}
+
+/**
+ * @brief Complete the message being sent, and send the next one.
+ * \param id		IPC unique ID.
+ * \param status	Result of the sending, "ipc_txStatus_t".
+ *
+ * Called by the port driver instead of "ipc_sendNextMsg" when the sending has failed.
+ */
+void
+ipc_sendComplete(ipcID_t id, uint8_t status)
+{
+	ipc_sendQ_t *sendQ;
+	uint8_t *ipcStatus;
 	
 	/* get the IPC send queue. */
 	sendQ = IPC_handlers[id].ipcSendQ;
-	status = IPC_handlers[id].status;
+	ipcStatus = &IPC_handlers[id].status;
+	
+	/* the message has left the port, release it. */
+	if(sendQ->txMsg != NULL)
+		ipc_sendRelease(id, sendQ->txMsg, status);
+	sendQ->txMsg = ipc_coalesce(sendQ, ipc_sendQ_next(sendQ));
+	ipc_flow_release(id);
 	
 	/* If next message is NULL, set the IPC port to be FREE. 
 	   Else, continue sending the next message. */
-	if(sendQ == NULL)
-		*status = IPC_FREE;
+	if(sendQ->txMsg == NULL)
+		*ipcStatus = IPC_FREE;
 	else
-		IPC_handlers[id].send_handler();
+		IPC_handlers[id].ops->send();
+}
+
+/**
+ * @brief Release a message which has left the IPC port.
+ * \param id		IPC unique ID.
+ * \param msgQ	The message.
+ * \param status	Result of the sending, "ipc_txStatus_t".
+ *
+ * For a coalesced frame, each original message of the batch is completed.
+ */
+static void
+ipc_sendRelease(ipcID_t id, ipc_msgRef_t msgQ, uint8_t status)
+{
+	ipc_sendQ_t *sendQ = IPC_handlers[id].ipcSendQ;
+	ipc_msgRef_t m;
+	
+	if(sendQ->coal != NULL && msgQ == IPC_FRAME_REF(sendQ->coal))
+	{
+		while((m = ipc_dequeue(&sendQ->coal->batch)) != NULL)
+		{
+			#if IPC_STATS
+			ipc_stats_tx(id, m, status);
+			#endif
+			ipc_msgQ_done(m, status);
+		}
+		return;
+	}
+	#if IPC_STATS
+	ipc_stats_tx(id, msgQ, status);
+	#endif
+	ipc_msgQ_done(msgQ, status);
+}
+
+/**
+ * @brief Get the message to be sent by the IPC port.
+ * \param id   IPC unique ID.
+ * \return	   The message being sent, NULL if none.
+ *
+ * Used by the "send" operation of the IPC port driver.
+ */
+ipc_msgQ_t *
+ipc_sendHead(ipcID_t id)
+{
+	ipc_sendQ_t *sendQ = IPC_handlers[id].ipcSendQ;
+	
+	if(sendQ->txMsg == NULL)	return NULL;
+	return IPC_MSG(sendQ->txMsg);
+}
+
+/**
+ * @brief Get a fragment of a message.
+ * \param msg		The message.
+ * \param i		Index of the fragment.
+ * \param base	Return the start of the fragment.
+ * \return		Fragment length, 0 if there is no such fragment.
+ *
+ * A contiguous message has one fragment. The drivers stream the fragments in order,
+ * thus a scatter-gather message is never assembled in RAM.
+ */
+uint8_t
+ipc_msg_frag(ipc_msgQ_t *msg, uint8_t i, uint8_t **base)
+{
+	ipc_iovec_t *iov;
+	
+	if(msg->iovcnt == 0)
+	{
+		if(i != 0)	return 0;
+		*base = msg->data;
+		return msg->size;
+	}
+	
+	if(i >= msg->iovcnt)	return 0;
+	iov = (ipc_iovec_t *)msg->data;
+	*base = iov[i].base;
+	return iov[i].len;
+}
+
+/**
+ * @brief Copy a part of a message into a contiguous buffer.
+ * \param msg		The message.
+ * \param offset	Offset in the message.
+ * \param dst		Destination buffer.
+ * \param len		Number of bytes to copy, not beyond the end of the message.
+ */
+void
+ipc_msg_copy(ipc_msgQ_t *msg, uint8_t offset, uint8_t *dst, uint8_t len)
+{
+	uint8_t *base;
+	uint8_t i, n, cnt;
+	
+	/* a contiguous message has one fragment. */
+	cnt = (msg->iovcnt != 0) ? msg->iovcnt : 1;
+	for(i = 0; len != 0 && i < cnt; i++)
+	{
+		n = ipc_msg_frag(msg, i, &base);
+		/* skip the fragments before the offset. */
+		if(offset >= n)
+		{
+			offset -= n;
+			continue;
+		}
+		base += offset;
+		n -= offset;
+		offset = 0;
+		if(n > len)
+			n = len;
+		memcpy(dst, base, n);
+		dst += n;
+		len -= n;
+	}
+}
+
+/**
+ * @brief Take the next message to be sent from the priority class queues.
+ * \param sendQ	The IPC sending queue.
+ * \return		The message, NULL if all the classes are empty.
+ *
+ * The highest non-empty class is served. Each waiting lower class 
+ * gets one message after IPC_PRIO_CREDIT messages of the higher classes, 
+ * the lowest one first if several of them have used up their credits.
+ */
+static ipc_msgRef_t
+ipc_sendQ_next(ipc_sendQ_t *sendQ)
+{
+	uint8_t c, top, cls = IPC_PRIO_NUM;
+	
+	/* get the highest non-empty class. */
+	for(c = 0; c < IPC_PRIO_NUM; c++)
+	{
+		if(sendQ->cls[c].head != NULL)
+		{
+			cls = c;
+			break;
+		}
+	}
+	if(cls == IPC_PRIO_NUM)	return NULL;
+	top = cls;
+	
+	#if IPC_PRIO_CREDIT
+	/* serve a waiting lower class once its credits are used up. */
+	for(c = IPC_PRIO_NUM - 1; c > cls; c--)
+	{
+		if(sendQ->cls[c].head != NULL && sendQ->credit[c] >= IPC_PRIO_CREDIT)
+		{
+			cls = c;
+			break;
+		}
+	}
+	
+	/* each waiting lower class passed over gets one more credit, 
+	   the served class, the highest one and the empty ones have none. */
+	for(c = 0; c < IPC_PRIO_NUM; c++)
+	{
+		if(c > top && c != cls && sendQ->cls[c].head != NULL)
+			sendQ->credit[c]++;
+		else
+			sendQ->credit[c] = 0;
+	}
+	#endif
+	
+	return ipc_dequeue(&sendQ->cls[cls]);
+}
+
+/**
+ * @brief Enable message coalescing on an IPC port.
+ * \param id		IPC unique ID.
+ * \param coal	Coalescing stage of the port.
+ * \param frame	Frame buffer, "mtu" bytes.
+ * \param mtu		Maximum frame length.
+ * \param small	Only the messages not longer than "small" bytes are coalesced.
+ * \param linger	Time in ms a small message waits on a free port for the following ones, 0 to send it at once.
+ *
+ * Consecutive small messages of the same class and option are sent in one frame,
+ * thus the "send" operation of the port is called once for all of them.
+ * Must be called before any message is sent on the port.
+ */
+void
+ipc_coalesce_init(ipcID_t id, ipc_coalesce_t *coal, uint8_t *frame, uint8_t mtu, uint8_t small, uint16_t linger)
+{
+	coal->frame = frame;
+	coal->mtu = mtu;
+	coal->small = small;
+	coal->linger = linger;
+	coal->lingering = 0;
+	coal->id = id;
+	
+	coal->batch.head = NULL;
+	coal->batch.tail = NULL;
+	coal->batch.len = 0;
+	coal->batch.bytes = 0;
+	
+	coal->frameMsg.next = NULL;
+	coal->frameMsg.data = frame;
+	coal->frameMsg.size = 0;
+	coal->frameMsg.option = 0;
+	coal->frameMsg.buf = NULL;
+	coal->frameMsg.prio = IPC_PRIO_NORMAL;
+	/* the frame is contiguous, and its messages are completed one by one. */
+	coal->frameMsg.done = NULL;
+	coal->frameMsg.iovcnt = 0;
+	#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+	coal->frameSlot = (uintptr_t)&coal->frameMsg;
+	#endif
+	
+	coal->lingerTimer.mode = TIMER_ONE_SHOT_MODE;
+	coal->lingerTimer.callback = ipc_linger_cb;
+	coal->lingerTimer.cb_data = coal;
+	
+	IPC_handlers[id].ipcSendQ->coal = coal;
+}
+
+/**
+ * @brief Gather the small messages following a message into one frame.
+ * \param sendQ	The IPC sending queue.
+ * \param msgQ	The message taken to be sent, NULL if none.
+ * \return		The frame if some messages have been gathered, else "msgQ".
+ *
+ * Called with the interrupts disabled or inside the sending ISR.
+ * The frame takes the priority class and the option of the first message.
+ */
+static ipc_msgRef_t
+ipc_coalesce(ipc_sendQ_t *sendQ, ipc_msgRef_t msgQ)
+{
+	ipc_coalesce_t *coal = sendQ->coal;
+	ipc_queue_t *q;
+	ipc_msgRef_t nxt;
+	uint8_t len;
+	
+	if(coal == NULL || msgQ == NULL || IPC_MSG(msgQ)->size > coal->small)
+		return msgQ;
+	
+	/* nothing to be coalesced with. */
+	q = &sendQ->cls[IPC_MSG(msgQ)->prio];
+	nxt = q->head;
+	if(nxt == NULL || IPC_MSG(nxt)->size > coal->small 
+	   || IPC_MSG(nxt)->option != IPC_MSG(msgQ)->option
+	   || IPC_MSG(msgQ)->size + IPC_MSG(nxt)->size > coal->mtu)
+		return msgQ;
+	
+	/* copy the messages into the frame, and keep them in the batch until the frame has been sent out. */
+	ipc_msg_copy(IPC_MSG(msgQ), 0, coal->frame, IPC_MSG(msgQ)->size);
+	len = IPC_MSG(msgQ)->size;
+	coal->frameMsg.option = IPC_MSG(msgQ)->option;
+	coal->frameMsg.prio = IPC_MSG(msgQ)->prio;
+	ipc_enqueue(&coal->batch, msgQ);
+	
+	while((nxt = q->head) != NULL && IPC_MSG(nxt)->size <= coal->small
+		  && IPC_MSG(nxt)->option == coal->frameMsg.option
+		  && len + IPC_MSG(nxt)->size <= coal->mtu)
+	{
+		ipc_dequeue(q);
+		ipc_msg_copy(IPC_MSG(nxt), 0, coal->frame + len, IPC_MSG(nxt)->size);
+		len += IPC_MSG(nxt)->size;
+		ipc_enqueue(&coal->batch, nxt);
+	}
+	coal->frameMsg.size = len;
+	
+	return IPC_FRAME_REF(coal);
+}
+
+/**
+ * @brief Linger timer callback, send the waiting small messages out.
+ * \param data	The coalescing stage.
+ */
+static void
+ipc_linger_cb(void *data)
+{
+	ipc_coalesce_t *coal = (ipc_coalesce_t *)data;
+	
+	coal->lingering = 0;
+	ipc_sendKick(coal->id);
+}
+
+
+/**
+ * @brief Get the number of messages waiting in the sending queue.
+ * \param sendQ	The IPC sending queue.
+ */
+static uint8_t
+ipc_sendQ_len(ipc_sendQ_t *sendQ)
+{
+	uint8_t c, len = 0;
+	
+	for(c = 0; c < IPC_PRIO_NUM; c++)
+		len += sendQ->cls[c].len;
+	return len;
+}
+
+/**
+ * @brief Make room for a new message in the sending queue of an IPC port.
+ * \param id		IPC unique ID.
+ * \param prio	Priority class of the new message.
+ * \return		0 if the message can be queued, QUEUE_FULL or TIMEOUT otherwise.
+ *
+ * Called before the message is allocated, according to the overflow policy of the port.
+ * A place is reserved for the admitted message, thus the concurrent senders cannot overrun the limit.
+ * It is taken by "ipc_submit", or given back by "ipc_flow_cancel" if the allocation is failed.
+ * With IPC_POLICY_BLOCK, only a RT thread waits, it must not be called from an ISR.
+ */
+static uint8_t
+ipc_flow_admit(ipcID_t id, uint8_t prio)
+{
+	HAS_CRITICAL_SECTION;
+	ipc_sendQ_t *sendQ = IPC_handlers[id].ipcSendQ;
+	ipc_flow_t *flow = &sendQ->flow;
+	ipc_msgRef_t victim = NULL;
+	uint8_t c, rslt = 0;
+	
+	if(prio >= IPC_PRIO_NUM)
+		prio = IPC_PRIO_LOW;
+	
+	ENTER_CRITICAL_SECTION;
+	while(flow->maxLen != 0 && ipc_sendQ_len(sendQ) + flow->reserved >= flow->maxLen)
+	{
+		/* wait until a message has been taken by the port, and then check again. */
+		if(flow->policy == IPC_POLICY_BLOCK && curThrd != &common_thread)
+		{
+			thrd_wait_prep(&flow->blockQ, flow->timeout);
+			LEAVE_CRITICAL_SECTION;
+			thread_dispatcher();
+			if(curThrd->wait_rslt != 0)
+				return curThrd->wait_rslt;
+			ENTER_CRITICAL_SECTION;
+			continue;
+		}
+		
+		if(flow->policy == IPC_POLICY_DROP_OLDEST)
+			victim = ipc_dequeue(&sendQ->cls[prio]);
+		else if(flow->policy == IPC_POLICY_DROP_LOWEST)
+		{
+			for(c = IPC_PRIO_NUM; c > prio && victim == NULL; c--)
+				victim = ipc_dequeue(&sendQ->cls[c - 1]);
+		}
+		if(victim == NULL)
+			rslt = QUEUE_FULL;
+		IPC_STATS_INC(id, drops);
+		break;
+	}
+	if(rslt == 0)
+		flow->reserved++;
+	LEAVE_CRITICAL_SECTION;
+	
+	if(victim != NULL)
+		ipc_msgQ_done(victim, IPC_TX_DROPPED);
+	
+	return rslt;
+}
+
+/**
+ * @brief Update the flow control after messages have left the sending queue.
+ * \param id		IPC unique ID.
+ *
+ * Called with the interrupts disabled or inside the sending ISR.
+ * The woken threads are scheduled at the next thread dispatching.
+ */
+static void
+ipc_flow_release(ipcID_t id)
+{
+	ipc_flow_t *flow = &IPC_handlers[id].ipcSendQ->flow;
+	uint8_t len = ipc_sendQ_len(IPC_handlers[id].ipcSendQ);
+	
+	/* notify the producer once the queue has been drained to half of the high-water mark. */
+	if(flow->congested && len <= flow->hwm / 2)
+	{
+		flow->congested = 0;
+		if(flow->notify != NULL)
+			flow->notify(id, 0);
+	}
+	
+	/* one waiting thread for each free place, the reserved places are not free. */
+	len += flow->reserved;
+	while(flow->blockQ != NULL && (flow->maxLen == 0 || len < flow->maxLen))
+	{
+		thrd_wait_done(flow->blockQ, 0);
+		len++;
+	}
 }
 
+/**
+ * @brief Give back the place reserved by "ipc_flow_admit" after a failed allocation.
+ * \param id		IPC unique ID.
+ */
+static void
+ipc_flow_cancel(ipcID_t id)
+{
+	HAS_CRITICAL_SECTION;
+	ipc_flow_t *flow = &IPC_handlers[id].ipcSendQ->flow;
+	
+	ENTER_CRITICAL_SECTION;
+	if(flow->reserved != 0)
+		flow->reserved--;
+	ipc_flow_release(id);
+	LEAVE_CRITICAL_SECTION;
+}
 
 /**
  * @brief The universal IPC receiving interface in the MIROS.
@@ -121,90 +1064,159 @@ ipc_sendNextMsg(ipcID_t id)
 uint8_t
 recv(ipcID_t id, void *msg, uint8_t size, uint16_t opt)
 {
-	ipc_msgQ_t **recvQ, *q;
-	#if	MEM_SFL
-		ipc_msgQ_t *msgQ;
-	#endif
-	#if	MEM_REACTIVE_SF
-		uint16_t *refMsg;
-	#endif	
+	ipc_msgRef_t msgQ;
+	
+	if(!IPC_PORT_VALID(id))	return PORT_UNREGISTERED;
 		
 	/* allocate a memory space for the IPC "ipc_msgQ_t" structure. */
-	#if MEM_SFL
-		msgQ = ipc_msgQ_alloc(msg, size, opt);
-		if(msgQ == NULL)	return MEM_ALLOC_ERROR;
-	#endif
-	#if MEM_REACTIVE_SF
-		refMsg = ipc_msgQ_alloc(msg, size, opt);
-		if(refMsg == NULL)	return MEM_ALLOC_ERROR;
-	#endif
-
-	/* get the corresponding IPC sending queue. Read from the AVR FLASH. */
-	recvQ = IPC_handlers[id].ipcRecvQ;
-
-	/* add this message to the IPC sending queue. */
-	if(*recvQ == NULL)
-	{
-		#if MEM_SFL
-			*recvQ = msgQ;
-		#endif
-		#if MEM_REACTIVE_SF
-			*recvQ = (ipc_msgQ_t *)*refMsg;
-		#endif
-	}
-	else
+	msgQ = ipc_msgQ_alloc(msg, size, opt);
+	if(msgQ == NULL)
 	{
-		for(q = *recvQ; q->next != NULL; q = q->next);
-		#if MEM_SFL
-			q->next = msgQ;
-		#endif
-		#if MEM_REACTIVE_SF
-			q->next = (ipc_msgQ_t *)*refMsg;
-		#endif
+		IPC_STATS_INC(id, allocFails);
+		return MEM_ALLOC_ERROR;
 	}
+
+	/* add this message to the tail of the IPC receiving queue. */
+	ipc_enqueue(IPC_handlers[id].ipcRecvQ, msgQ);
+	#if IPC_STATS
+	IPC_handlers[id].stats.rxMsgs++;
+	IPC_handlers[id].stats.rxBytes += size;
+	#endif
 		
 	/* put the message into the buffer, and then call the receiving handler. */
-	IPC_handlers[id].recv_handler();
+	IPC_handlers[id].ops->recv();
 		
 	return 0;
 }
 
+/**
+ * @brief Add a message to the tail of an IPC queue.
+ * \param q		The IPC queue.
+ * \param msgQ	The message to be added.
+ *
+ * The tail is recorded in the queue descriptor, thus no list walk is required.
+ */
+void
+ipc_enqueue(ipc_queue_t *q, ipc_msgRef_t msgQ)
+{
+	HAS_CRITICAL_SECTION;
+	
+	IPC_MSG(msgQ)->next = NULL;
+	
+	ENTER_CRITICAL_SECTION;
+	if(q->head == NULL)
+		q->head = msgQ;
+	else
+		IPC_MSG(q->tail)->next = msgQ;
+	q->tail = msgQ;
+	q->len++;
+	q->bytes += IPC_MSG(msgQ)->size;
+	LEAVE_CRITICAL_SECTION;
+}
+
+/**
+ * @brief Delete the message from the head of an IPC queue.
+ * \param q		The IPC queue.
+ * \return		The deleted message, NULL if the queue is empty.
+ */
+ipc_msgRef_t
+ipc_dequeue(ipc_queue_t *q)
+{
+	HAS_CRITICAL_SECTION;
+	ipc_msgRef_t msgQ;
+	
+	ENTER_CRITICAL_SECTION;
+	msgQ = q->head;
+	if(msgQ != NULL)
+	{
+		q->head = IPC_MSG(msgQ)->next;
+		if(q->head == NULL)
+			q->tail = NULL;
+		q->len--;
+		q->bytes -= IPC_MSG(msgQ)->size;
+	}
+	LEAVE_CRITICAL_SECTION;
+	
+	return msgQ;
+}
+
 /**
  * @brief Allocate an IPC message structure and then init it.
  * \param msg  Message to be received.
  * \param size Message length.
  * \param opt  Sending option, can be a pointer, or a 16-bit word.
- * \return	return the allocated memory address.
+ * \return	return the allocated message, its reference with the SF allocators.
  *
  */
-void *
+ipc_msgRef_t
 ipc_msgQ_alloc(void *msg, uint8_t size, uint16_t opt)
 {
+	ipc_msgRef_t msgQ = NULL;
+	
+	#if IPC_BENCH
+	ipc_allocCalls++;
+	#endif
 	/* allocate a message structure, and then init it. */
 	#if MEM_SFL
-		ipc_msgQ_t *msgQ = NULL;
 		msgQ = mem_alloc(&ipc_pt);
-		if(msgQ != NULL)
-		{
-			msgQ->data = msg;
-			msgQ->size = size;
-			msgQ->option = opt;
-			msgQ->next = NULL;
-			return msgQ;
-		}
 	#endif
-	#if MEM_REACTIVE_SF
-		uint16_t *refMsg = NULL;
-		refMsg = mem_alloc(sizeof(ipc_msgQ_t));
-		if(refMsg != NULL)
-		{
-			((ipc_msgQ_t *)(*refMsg))->data = msg;
-			((ipc_msgQ_t *)(*refMsg))->size = size;
-			((ipc_msgQ_t *)(*refMsg))->option = opt;
-			((ipc_msgQ_t *)(*refMsg))->next = NULL;
-			return refMsg;
-		}
-	#endif	
+	#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF || MEM_TLSF
+		msgQ = mem_alloc(sizeof(ipc_msgQ_t));
+	#endif
+	
+	if(msgQ != NULL)
+	{
+		IPC_MSG(msgQ)->data = msg;
+		IPC_MSG(msgQ)->size = size;
+		IPC_MSG(msgQ)->option = opt;
+		IPC_MSG(msgQ)->buf = NULL;
+		IPC_MSG(msgQ)->prio = IPC_PRIO_NORMAL;
+		IPC_MSG(msgQ)->done = NULL;
+		IPC_MSG(msgQ)->iovcnt = 0;
+		IPC_MSG(msgQ)->next = NULL;
+	}
 
-	return NULL;
+	return msgQ;
+}
+
+/**
+ * @brief Release an IPC message structure.
+ * \param msgQ	The message, its reference with the SF allocators.
+ *
+ * The reference to the network buffer is released as well, if any.
+ */
+void
+ipc_msgQ_free(ipc_msgRef_t msgQ)
+{
+	if(IPC_MSG(msgQ)->buf != NULL)
+		netbuf_free(IPC_MSG(msgQ)->buf);
+	mem_free(msgQ);
+	#if IPC_BENCH
+	ipc_allocCalls++;
+	#endif
+}
+
+/**
+ * @brief Release a sent message, and then report its completion.
+ * \param msgQ	The message, its reference with the SF allocators.
+ * \param status	Result of the sending, "ipc_txStatus_t".
+ */
+void
+ipc_msgQ_done(ipc_msgRef_t msgQ, uint8_t status)
+{
+	ipc_txDone_t *done = IPC_MSG(msgQ)->done;
+	
+	ipc_msgQ_free(msgQ);
+	if(done == NULL)	return;
+	
+	done->status = status;
+	#if TIMER_ACV
+	done->timestamp = GetSysTime();
+	#else
+	done->timestamp = 0;
+	#endif
+	if(done->cb != NULL)
+		done->cb(done);
+	else
+		taskPost(done->tskID);
 }
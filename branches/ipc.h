@@ -13,18 +13,41 @@
 #define _IPC_H_
 
 /* === INCLUDES ============================================================ */
+#include "board.h"
+#include "kernel.h"
+#include "netbuf.h"
+#include "mem_ref.h"
 
 
 /* === MACROS ============================================================== */
 /* Every software or hardware IPC component has a unique ID.
    The "send" and "recv" operations will put the messages to the corresponded message queue
-   in terms of this ID. */
+   in terms of this ID. A port must be registered by "ipc_register_port" before it is used,
+   and its ID must be less than IPC_PORT_MAX. */
 typedef enum ipcID
 {
 	USART_ID,
 	WIRELESS_TX_ID,
+	LOOPBACK_ID,		/* software loopback port, with IPC_LOOPBACK. */
 } ipcID_t;
 
+/* size of the IPC port table. */
+#define IPC_PORT_MAX		4
+
+/* Overflow policies of an IPC port, applied before a new message is allocated
+   when the sending queue holds "maxLen" messages. */
+typedef enum ipc_policy
+{
+	IPC_POLICY_REJECT,			/* the new message is rejected with QUEUE_FULL. */
+	IPC_POLICY_DROP_OLDEST,		/* the oldest message of the same class is dropped. */
+	IPC_POLICY_DROP_LOWEST,		/* the oldest message of the lowest class, not higher than the new one, is dropped. */
+	IPC_POLICY_BLOCK,			/* a RT thread waits for room, the others are rejected. */
+} ipc_policy_t;
+
+/* default limit of the sending queue of a registered port, and its high-water mark. */
+#define IPC_QLEN_DEFAULT	8
+#define IPC_HWM_DEFAULT		6
+
 /* Status of the IPC queue. When the queue is free, send the messages immediately.
    When the queue if busy, store the messages in the buffering queues. */
 typedef enum ipc_status
@@ -34,32 +57,213 @@ typedef enum ipc_status
 	IPC_FREE,
 } ipc_status_t;
 
+/* Priority classes of the IPC messages. 
+   The sending queue of each IPC port has one queue per class, 
+   and the highest non-empty class is always served first. */
+typedef enum ipc_prio
+{
+	IPC_PRIO_HIGH,
+	IPC_PRIO_NORMAL,
+	IPC_PRIO_LOW,
+	IPC_PRIO_NUM,
+} ipc_prio_t;
+
+/* Anti-starvation: after IPC_PRIO_CREDIT messages served from the higher classes
+   while a lower class is waiting, one message of this lower class is served. 
+   Each class has its own credit, thus no waiting class is starved. 0 to disable. */
+#define IPC_PRIO_CREDIT		8
+
 /* === TYPES =============================================================== */
-/* structure for the message sending and receiving operations from the IPC. */
-typedef struct ipc_msgQ
+/* reference to an IPC message.
+   With the SF allocators the messages can be moved when the fragments are assembled,
+   thus they are linked by their references instead of their addresses. */
+typedef struct ipc_msgQ ipc_msgQ_t;
+#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+typedef uint16_t* ipc_msgRef_t;
+#define IPC_MSG(ref)	((ipc_msgQ_t *)MEM_REF(ref))
+#else
+typedef ipc_msgQ_t* ipc_msgRef_t;
+#define IPC_MSG(ref)	(ref)
+#endif
+
+/* result of a message sending, reported by the send completion. */
+typedef enum ipc_txStatus
+{
+	IPC_TX_OK,				/* sent out by the port. */
+	IPC_TX_FAILED,			/* the port failed to send it. */
+	IPC_TX_DROPPED,			/* dropped by the overflow policy of the port. */
+	IPC_TX_FLUSHED,			/* dropped by "ipc_flush". */
+} ipc_txStatus_t;
+
+/* Send completion, provided by the sender of "send_async".
+   Once the message has left the IPC port, "status" and "timestamp" are filled, 
+   and then "cb" is called, or the task "tskID" is posted if "cb" is NULL.
+   "cb" may be called from an ISR. */
+typedef struct ipc_txDone ipc_txDone_t;
+typedef void (*ipc_txDone_cb_t)(ipc_txDone_t *done);
+struct ipc_txDone
+{
+	ipc_txDone_cb_t cb;
+	uint8_t tskID;
+	uint8_t status;			/* "ipc_txStatus_t". */
+	uint32_t timestamp;		/* system time in ms when the message left the port, 0 without TIMER_ACV. */
+};
+
+/* fragment of a scatter-gather message sent by "sendv". */
+typedef struct ipc_iovec
+{
+	uint8_t *base;
+	uint8_t len;
+} ipc_iovec_t;
+
+/* structure for the message sending and receiving operations from the IPC. 
+   For a scatter-gather message, "data" points to "iovcnt" fragments "ipc_iovec_t", 
+   and "size" is their total length. The drivers get the fragments by "ipc_msg_frag". */
+struct ipc_msgQ
 {
-	struct ipc_msgQ *next;
+	ipc_msgRef_t next;
 	uint8_t *data;		/* message to be sent or has been received. */
 	uint8_t size;		/* message length. */
 	uint16_t option;	/* send or recv option. */
-} ipc_msgQ_t;
+	netbuf_t *buf;		/* network buffer holding "data", released with the message. */
+	uint8_t prio;		/* priority class, "ipc_prio_t". */
+	ipc_txDone_t *done;	/* send completion, NULL if none. */
+	uint8_t iovcnt;		/* number of fragments, 0 if "data" is contiguous. */
+	#if IPC_STATS
+	uint16_t tEnq;		/* system time in ms when the message was queued, wraps around every 65.5 s. */
+	#endif
+};
 
-/* structure to define the IPC send and recv handlers. */
+/* IPC message queue descriptor, enqueue and dequeue are done in constant time. */
+typedef struct ipc_queue
+{
+	ipc_msgRef_t head;	/* first message. */
+	ipc_msgRef_t tail;	/* last message, new messages are linked after it. */
+	uint8_t len;		/* number of messages in the queue. */
+	uint16_t bytes;		/* total data length of the messages in the queue. */
+} ipc_queue_t;
+
+/* Optional coalescing stage of an IPC port.
+   Consecutive small messages of the same priority class are copied into "frame",
+   and sent out by one call of the "send" operation of the port. 
+   The original messages are kept in "batch" and released once the frame has been sent out. */
+typedef struct ipc_coalesce
+{
+	uint8_t *frame;			/* frame buffer provided by the IPC port, "mtu" bytes. */
+	uint8_t mtu;			/* maximum frame length. */
+	uint8_t small;			/* only the messages not longer than "small" are coalesced. */
+	uint16_t linger;		/* time in ms to wait for more small messages on an idle port, 0 to disable. */
+	uint8_t lingering;		/* the linger timer is running. */
+	timer_t lingerTimer;
+	ipc_queue_t batch;		/* original messages copied into the frame being sent. */
+	ipc_msgQ_t frameMsg;	/* message describing the frame. */
+	#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+	uintptr_t frameSlot;	/* reference of "frameMsg", it is never moved. */
+	#endif
+	ipcID_t id;
+} ipc_coalesce_t;
+
+/* Flow control of an IPC port. 
+   "notify" is called with 1 when the queue reaches the high-water mark, 
+   and with 0 when it is drained to half of it. It may be called from an ISR. */
+typedef void (*ipc_backpressure_t)(ipcID_t id, uint8_t congested);
+typedef struct ipc_flow
+{
+	uint8_t maxLen;				/* max number of waiting messages, 0 for no limit. */
+	uint8_t hwm;				/* high-water mark, 0 for no backpressure notification. */
+	uint8_t policy;				/* "ipc_policy_t". */
+	uint8_t congested;			/* the high-water mark has been reached. */
+	uint8_t reserved;			/* places taken by the admitted messages not queued yet. */
+	uint16_t timeout;			/* blocking time in ms with IPC_POLICY_BLOCK, or WAIT_FOREVER. */
+	ipc_backpressure_t notify;
+	thrd_tcb_t *blockQ;			/* threads waiting for room. */
+} ipc_flow_t;
+
+/* IPC sending queue descriptor, with one queue per priority class. */
+typedef struct ipc_sendQ
+{
+	ipc_queue_t cls[IPC_PRIO_NUM];	/* messages waiting to be sent, per priority class. */
+	ipc_msgRef_t txMsg;				/* message being sent by the IPC port. */
+	uint8_t credit[IPC_PRIO_NUM];	/* messages served from the higher classes while this class is waiting. */
+	ipc_coalesce_t *coal;			/* coalescing stage, NULL if disabled. */
+	ipc_flow_t flow;				/* queue limit and overflow policy. */
+} ipc_sendQ_t;
+
+/* operations of an IPC port, provided by its driver.
+   "send" sends the message given by "ipc_sendHead" fragment by fragment ("ipc_msg_frag"), 
+   and "ipc_sendNextMsg" (or "ipc_sendComplete" on failure) must be called once it has been sent out.
+   "recv" gets the received messages from the receiving queue by "ipc_dequeue".
+   "flush" aborts the message being sent, NULL if not supported.
+   "stats" fills the driver specific statistics, NULL if none. */
 typedef uint8_t (*ipcHandler_t)(void);
+typedef uint8_t (*ipcStatsHandler_t)(void *stats);
+typedef struct ipc_ops
+{
+	ipcHandler_t send;
+	ipcHandler_t recv;
+	ipcHandler_t flush;
+	ipcStatsHandler_t stats;
+} ipc_ops_t;
+
+/* Counters of an IPC port, with IPC_STATS. 
+   The average queueing latency is "latency" / "txMsgs", from "send" until the message has been sent out. 
+   The latency of a message is taken modulo 65536 ms, a message queued for longer is counted short. */
+typedef struct ipc_stats
+{
+	uint16_t txMsgs;			/* messages sent out. */
+	uint32_t txBytes;
+	uint16_t rxMsgs;			/* messages received. */
+	uint32_t rxBytes;
+	uint16_t allocFails;		/* messages lost because the allocator has failed. */
+	uint16_t drops;				/* messages rejected or dropped by the overflow policy. */
+	uint8_t peakDepth;			/* max number of messages waiting to be sent. */
+	uint32_t latency;			/* cumulative queueing latency of the sent messages in ms. */
+} ipc_stats_t;
+
+/* entry of the IPC port table, indexed by the IPC ID. */
 typedef struct ipc_register
 {
-	uint8_t *status;
-	ipcHandler_t send_handler;
-	void *ipcSendQ;
-	ipcHandler_t recv_handler;
-	void *ipcRecvQ;
+	uint8_t status;				/* "ipc_status_t" of the port. */
+	const ipc_ops_t *ops;		/* NULL if the port is not registered. */
+	ipc_sendQ_t *ipcSendQ;
+	ipc_queue_t *ipcRecvQ;
+	#if IPC_STATS
+	ipc_stats_t stats;
+	#endif
 } ipc_register_t;
 
 /* === GLOBALS ============================================================= */
+#if IPC_BENCH
+extern uint32_t ipc_allocCalls;
+#endif
+extern void ipc_init(void);
+extern uint8_t ipc_register_port(ipcID_t id, const ipc_ops_t *ops, ipc_sendQ_t *sendQ, ipc_queue_t *recvQ);
+extern uint8_t ipc_flush(ipcID_t id);
+extern uint8_t ipc_flow_init(ipcID_t id, uint8_t maxLen, uint8_t hwm, uint8_t policy, uint16_t timeout, ipc_backpressure_t notify);
+extern uint8_t ipc_port_stats(ipcID_t id, void *stats);
+#if IPC_STATS
+extern uint8_t ipc_stats_get(ipcID_t id, ipc_stats_t *stats);
+extern void ipc_stats_reset(ipcID_t id);
+extern void ipc_stats_dump(ipcID_t id);
+#endif
 extern uint8_t send(ipcID_t id, void *msg, uint8_t size, uint16_t opt);
+extern uint8_t send_prio(ipcID_t id, void *msg, uint8_t size, uint16_t opt, uint8_t prio);
+extern uint8_t send_async(ipcID_t id, void *msg, uint8_t size, uint16_t opt, uint8_t prio, ipc_txDone_t *done);
+extern uint8_t sendv(ipcID_t id, ipc_iovec_t *iov, uint8_t n, uint16_t opt);
+extern uint8_t send_buf(ipcID_t id, netbuf_t *buf, uint16_t opt, uint8_t prio);
+extern uint8_t ipc_submit(ipcID_t id, ipc_msgRef_t msgQ);
 extern void ipc_sendNextMsg(ipcID_t id);
+extern void ipc_sendComplete(ipcID_t id, uint8_t status);
+extern ipc_msgQ_t *ipc_sendHead(ipcID_t id);
+extern uint8_t ipc_msg_frag(ipc_msgQ_t *msg, uint8_t i, uint8_t **base);
+extern void ipc_msg_copy(ipc_msgQ_t *msg, uint8_t offset, uint8_t *dst, uint8_t len);
+extern void ipc_coalesce_init(ipcID_t id, ipc_coalesce_t *coal, uint8_t *frame, uint8_t mtu, uint8_t small, uint16_t linger);
 extern uint8_t recv(ipcID_t id, void *msg, uint8_t size, uint16_t opt);
-extern void *ipc_msgQ_alloc(void *msg, uint8_t size, uint16_t opt);
+extern ipc_msgRef_t ipc_msgQ_alloc(void *msg, uint8_t size, uint16_t opt);
+extern void ipc_msgQ_free(ipc_msgRef_t msgQ);
+extern void ipc_msgQ_done(ipc_msgRef_t msgQ, uint8_t status);
+extern void ipc_enqueue(ipc_queue_t *q, ipc_msgRef_t msgQ);
+extern ipc_msgRef_t ipc_dequeue(ipc_queue_t *q);
 
 
 
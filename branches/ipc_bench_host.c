@@ -0,0 +1,102 @@
+/**
+ * @file ipc_bench_host.c
+ * 
+ * @brief	Entry of the IPC benchmark in the host build.
+ *			Built with IPC_LOOPBACK, IPC_BENCH and IPC_BENCH_HOST, together with the IPC and the memory allocator,
+ *			it runs the benchmark on the loopback port for several message sizes and backlog depths:
+ *			"ipc_bench [rounds]". It is built by host/Makefile ("make -C host ipc_bench_host ALLOC=MEM_SFL").
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#if IPC_BENCH_HOST
+/* the host "timer_t" is renamed, the MIROS one is used. */
+#define timer_t host_timer_t
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#undef timer_t
+#endif
+#include "typedef.h"
+#include "board.h"
+#include "kernel.h"
+#include "os_start.h"
+#include "netbuf.h"
+#include "ipc.h"
+#include "ipc_loopback.h"
+#include "mem_quota.h"
+
+#if IPC_LOOPBACK && IPC_BENCH && IPC_BENCH_HOST
+
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+#define BENCH_ROUNDS	1000
+
+
+/* === GLOBALS ============================================================= */
+static const uint8_t benchSizes[] = {8, 16, 32, 64};
+static const uint8_t benchDepths[] = {1, 4, 8, 16};
+
+
+/* === PROTOTYPES ========================================================== */
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Clock of the benchmark in us.
+ */
+uint32_t
+ipc_bench_clock(void)
+{
+	struct timeval tv;
+	
+	gettimeofday(&tv, NULL);
+	return (uint32_t)(tv.tv_sec * 1000000ul + tv.tv_usec);
+}
+
+int
+main(int argc, char **argv)
+{
+	ipc_bench_t b;
+	uint8_t i, j;
+	
+	b.rounds = (argc > 1) ? (uint16_t)atoi(argv[1]) : BENCH_ROUNDS;
+	
+	/* the same initialization as "software_init", for the IPC. */
+	curThrd = &common_thread;
+	#if MEM_QUOTA
+	mem_quota_init(curThrd);
+	#endif
+	heapSaddr = &_sys_data_end;
+	mem_init();
+	netbuf_init();
+	ipc_init();
+	
+	printf("size depth     msg/s  alloc/msg  enq_max(us)  failed\n");
+	for(i = 0; i < sizeof(benchSizes); i++)
+	{
+		for(j = 0; j < sizeof(benchDepths); j++)
+		{
+			b.size = benchSizes[i];
+			b.depth = benchDepths[j];
+			if(ipc_bench_run(&b) != 0)
+			{
+				printf("loopback port is not registered\n");
+				return 1;
+			}
+			printf("%4u %5u %9lu %10.2f %12lu %7u\n", b.size, b.depth, 
+				   (unsigned long)IPC_BENCH_RATE(&b), 
+				   b.msgs ? (double)b.allocCalls / b.msgs : 0.0,
+				   (unsigned long)b.enqMax, b.failed);
+		}
+	}
+	
+	return 0;
+}
+
+#endif	/* #if IPC_LOOPBACK && IPC_BENCH && IPC_BENCH_HOST */
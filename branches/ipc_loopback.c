@@ -0,0 +1,203 @@
+/**
+ * @file ipc_loopback.c
+ * 
+ * @brief	Software loopback IPC port, and the IPC benchmark.
+ *			Each message sent to LOOPBACK_ID is completed at once and received again by the same port, 
+ *			thus the cost of the IPC can be measured without the USART or radio hardware.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include "typedef.h"
+#include "board.h"
+#include "kernel.h"
+#include "ipc.h"
+#include "ipc_loopback.h"
+
+#if IPC_LOOPBACK
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+
+
+/* === GLOBALS ============================================================= */
+/* queues of the loopback port. */
+ipc_sendQ_t lbSendQ;
+ipc_queue_t lbRecvQ;
+
+/* handler of the received messages, NULL to release them. */
+static ipcHandler_t lbConsumer;
+
+/* "lbActive": the sending loop is running. "lbPending": a message is waiting for the loop.
+   "lbHold": the messages are kept in the sending queue. */
+static volatile uint8_t lbActive, lbPending, lbHold;
+
+#if IPC_BENCH
+static uint32_t lbRecvCnt;
+#endif
+
+/* === PROTOTYPES ========================================================== */
+static uint8_t ipc_loopback_send(void);
+static uint8_t ipc_loopback_recv(void);
+static uint8_t ipc_loopback_flush(void);
+
+static const ipc_ops_t lb_ops = 
+{
+	ipc_loopback_send, ipc_loopback_recv, ipc_loopback_flush, NULL
+};
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Register the loopback port.
+ * \param consumer	Handler of the received messages, which gets them from "lbRecvQ" by "ipc_dequeue".
+ *					NULL to release them at once.
+ * \return			Return value of "ipc_register_port".
+ *
+ * The received message refers to the data of the sent one, which is only valid inside "consumer".
+ */
+uint8_t
+ipc_loopback_init(ipcHandler_t consumer)
+{
+	lbConsumer = consumer;
+	lbActive = lbPending = lbHold = 0;
+	
+	return ipc_register_port(LOOPBACK_ID, &lb_ops, &lbSendQ, &lbRecvQ);
+}
+
+/**
+ * @brief Hold or release the loopback port.
+ * \param hold	1 to keep the messages in the sending queue, 0 to send them all.
+ *
+ * Used to build a backlog on the port.
+ */
+void
+ipc_loopback_hold(uint8_t hold)
+{
+	lbHold = hold;
+	if(!hold && ipc_sendHead(LOOPBACK_ID) != NULL)
+		ipc_loopback_send();
+}
+
+/**
+ * @brief Send operation of the loopback port.
+ *
+ * The message is received again and completed, and then "ipc_sendNextMsg" calls this operation for the next one.
+ * The calls are turned into a loop, thus the stack does not grow with the backlog.
+ */
+static uint8_t
+ipc_loopback_send(void)
+{
+	ipc_msgQ_t *msg;
+	ipc_msgRef_t rxMsg;
+	
+	lbPending = 1;
+	if(lbActive || lbHold)	return 0;
+	
+	lbActive = 1;
+	while(lbPending && !lbHold)
+	{
+		lbPending = 0;
+		msg = ipc_sendHead(LOOPBACK_ID);
+		if(msg == NULL)	break;
+		
+		/* receive the message, without copying the data. */
+		rxMsg = ipc_msgQ_alloc(msg->data, msg->size, msg->option);
+		if(rxMsg != NULL)
+		{
+			IPC_MSG(rxMsg)->iovcnt = msg->iovcnt;
+			ipc_enqueue(&lbRecvQ, rxMsg);
+			ipc_loopback_recv();
+		}
+		ipc_sendComplete(LOOPBACK_ID, rxMsg != NULL ? IPC_TX_OK : IPC_TX_FAILED);
+	}
+	lbActive = 0;
+	
+	return 0;
+}
+
+/**
+ * @brief Receive operation of the loopback port.
+ */
+static uint8_t
+ipc_loopback_recv(void)
+{
+	ipc_msgRef_t msgQ;
+	
+	if(lbConsumer != NULL)
+		return lbConsumer();
+	
+	while((msgQ = ipc_dequeue(&lbRecvQ)) != NULL)
+	{
+		#if IPC_BENCH
+		lbRecvCnt++;
+		#endif
+		ipc_msgQ_free(msgQ);
+	}
+	return 0;
+}
+
+/**
+ * @brief Flush operation of the loopback port, nothing is in progress outside the sending loop.
+ */
+static uint8_t
+ipc_loopback_flush(void)
+{
+	lbPending = 0;
+	return 0;
+}
+
+#if IPC_BENCH
+/**
+ * @brief Run the IPC benchmark on the loopback port.
+ * \param b		Benchmark run, "size", "depth" and "rounds" are given by the caller.
+ * \return		0, or PORT_UNREGISTERED if the loopback port is not registered.
+ *
+ * The loopback port must have no consumer. Its queue limit is removed for the run.
+ */
+uint8_t
+ipc_bench_run(ipc_bench_t *b)
+{
+	static uint8_t payload[0xFF];
+	uint32_t start, t;
+	uint16_t r;
+	uint8_t d, rslt;
+	
+	rslt = ipc_flow_init(LOOPBACK_ID, 0, 0, IPC_POLICY_REJECT, WAIT_FOREVER, NULL);
+	if(rslt != 0)	return rslt;
+	
+	b->msgs = 0;
+	b->enqMax = 0;
+	b->failed = 0;
+	lbRecvCnt = 0;
+	ipc_allocCalls = 0;
+	
+	start = IPC_BENCH_CLOCK();
+	for(r = 0; r < b->rounds; r++)
+	{
+		/* build the backlog, and then send it out. */
+		ipc_loopback_hold(1);
+		for(d = 0; d < b->depth; d++)
+		{
+			t = IPC_BENCH_CLOCK();
+			if(send(LOOPBACK_ID, payload, b->size, 0) != 0)
+				b->failed++;
+			t = IPC_BENCH_CLOCK() - t;
+			if(t > b->enqMax)
+				b->enqMax = t;
+		}
+		ipc_loopback_hold(0);
+	}
+	b->elapsed = IPC_BENCH_CLOCK() - start;
+	b->msgs = lbRecvCnt;
+	b->allocCalls = ipc_allocCalls;
+	
+	ipc_flow_init(LOOPBACK_ID, IPC_QLEN_DEFAULT, IPC_HWM_DEFAULT, IPC_POLICY_REJECT, WAIT_FOREVER, NULL);
+	return 0;
+}
+#endif	/* #if IPC_BENCH */
+
+#endif	/* #if IPC_LOOPBACK */
@@ -0,0 +1,71 @@
+/**
+ * @file ipc_loopback.h
+ *
+ * @brief  header for ipc_loopback.c
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _IPC_LOOPBACK_H_
+#define _IPC_LOOPBACK_H_ 
+ 
+/* === Includes ============================================================= */
+#include "board.h"
+#include "ipc.h"
+
+/* The loopback port is built with IPC_LOOPBACK, and the IPC benchmark with IPC_BENCH (which requires IPC_LOOPBACK).
+   Both are set in "sys_config.h". */
+#if IPC_LOOPBACK
+
+/* === Macros =============================================================== */
+#if IPC_BENCH
+/* Clock of the benchmark in us. The host build (IPC_BENCH_HOST) provides "ipc_bench_clock".
+   On the node, the system time is used, thus only the long runs are meaningful. */
+#if IPC_BENCH_HOST
+#define IPC_BENCH_CLOCK()		ipc_bench_clock()
+#else
+#define IPC_BENCH_CLOCK()		(GetSysTime() * 1000ul)
+#endif
+
+/* messages per second of a benchmark run. */
+#define IPC_BENCH_RATE(b)		((b)->elapsed ? (uint32_t)((uint64_t)(b)->msgs * 1000000ul / (b)->elapsed) : 0)
+#endif
+
+
+/* === Types ================================================================ */
+#if IPC_BENCH
+/* One benchmark run: "rounds" times, "depth" messages of "size" bytes are queued on the held port, 
+   and then the port is released to send them all. */
+typedef struct ipc_bench
+{
+	uint8_t size;				/* message length. */
+	uint8_t depth;				/* backlog of the port in each round. */
+	uint16_t rounds;
+	
+	uint32_t msgs;				/* messages received by the loopback port. */
+	uint32_t elapsed;			/* time of the run in us. */
+	uint32_t allocCalls;		/* allocator calls of the IPC during the run. */
+	uint32_t enqMax;			/* worst time of a "send" in us. */
+	uint16_t failed;			/* messages rejected by "send". */
+} ipc_bench_t;
+#endif
+
+
+/* === GLOBALS ============================================================= */
+
+
+/* === Prototypes =========================================================== */
+extern uint8_t ipc_loopback_init(ipcHandler_t consumer);
+extern void ipc_loopback_hold(uint8_t hold);
+#if IPC_BENCH
+extern uint8_t ipc_bench_run(ipc_bench_t *b);
+#if IPC_BENCH_HOST
+extern uint32_t ipc_bench_clock(void);
+#endif
+#endif
+
+#endif	/* #if IPC_LOOPBACK */
+#endif
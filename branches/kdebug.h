@@ -53,6 +53,9 @@ typedef enum
 	thrd_sched_debugID,
 	evt_sched_debugID,
 	memAlloc_debugID,
+	ipcStats_debugID,
+	memTrace_debugID,
+	memStats_debugID,
 	END_ID,
 } kdebugCmdId_t;
 
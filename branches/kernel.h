@@ -26,6 +26,11 @@ typedef enum kRuntime_status
 {
 	ERROR,
 	MEM_ALLOC_ERROR,
+	TIMEOUT,
+	QUEUE_FULL,
+	QUEUE_EMPTY,
+	PORT_UNREGISTERED,
+	MSG_SIZE_ERROR,
 } kRuntime_status_t;
 
 /* === GLOBALS ============================================================= */
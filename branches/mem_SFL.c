@@ -28,6 +28,9 @@
 #include "mem_SFL.h"
 #include "mem_SFL_extHeap.h"
 #include "ipc.h"
+#include "mem_trace.h"
+#include "mem_quota.h"
+#include "mem_stats.h"
 
 #if	MEM_SFL
 
@@ -35,11 +38,39 @@
 
 
 /* === MACROS ============================================================== */
-/* create partitions here: MEM_PARTITION_CREATE(name, struct_name, blkNum) */
-MEM_PARTITION_CREATE(timer, timer_t, 2);	/* create partition for software timer, with 10 blocks. */
-MEM_PARTITION_CREATE(ipc, ipc_msgQ_t, 2);	/* create partition for IPC sending/recving, with 30 blocks. */
+/* create the partitions of the table "MEM_PARTITION_TABLE". */
+#define MEM_PARTITION_DEF(name, blkSize, blkNum, a) \
+	MEM_PARTITION_CREATE_SZ(name, blkSize, blkNum);
+MEM_PARTITION_TABLE(MEM_PARTITION_DEF, _)
+
+/* index of each partition in "mem_partitions". */
+#define MEM_PARTITION_IDX(name, blkSize, blkNum, a)	CC_CONCAT(MEM_PT_, name),
+enum { MEM_PARTITION_TABLE(MEM_PARTITION_IDX, _) MEM_PARTITION_NUM };
+
+/* size class of the requested size "sz": the first fitting one of "MEM_SIZE_CLASSES", or MEM_NO_CLASS. */
+#define MEM_LUT_FIT(name, blkSize, blkNum, sz)	((sz) <= (blkSize)) ? CC_CONCAT(MEM_PT_, name) :
+#define MEM_LUT_CLASS(i)	(MEM_SIZE_CLASSES(MEM_LUT_FIT, (i) * MEM_LUT_GRAIN) MEM_NO_CLASS)
+#define MEM_LUT_ROW(i)		MEM_LUT_CLASS(i), MEM_LUT_CLASS((i) + 1), MEM_LUT_CLASS((i) + 2), MEM_LUT_CLASS((i) + 3), \
+							MEM_LUT_CLASS((i) + 4), MEM_LUT_CLASS((i) + 5), MEM_LUT_CLASS((i) + 6), MEM_LUT_CLASS((i) + 7)
+#if MEM_LUT_NUM != 64
+#error "the rows of mem_lut are written for 64 entries."
+#endif
 
 /* === GLOBALS ============================================================= */
+/* all the partitions, in the order of the partition table. */
+#define MEM_PARTITION_PTR(name, blkSize, blkNum, a)	&CC_CONCAT(name,_pt),
+partition_t * const mem_partitions[] = 
+{
+	MEM_PARTITION_TABLE(MEM_PARTITION_PTR, _)
+};
+
+/* size class of each MEM_LUT_GRAIN bytes of the requested size, index in "mem_partitions". 
+   Generated from the size classes, and kept in the FLASH. */
+const uint8_t mem_lut[MEM_LUT_NUM] PROGMEM = 
+{
+	MEM_LUT_ROW(0), MEM_LUT_ROW(8), MEM_LUT_ROW(16), MEM_LUT_ROW(24),
+	MEM_LUT_ROW(32), MEM_LUT_ROW(40), MEM_LUT_ROW(48), MEM_LUT_ROW(56)
+};
 
 
 /* === PROTOTYPES ========================================================== */
@@ -72,6 +103,46 @@ memSFL_partition_init(partition_t *pt)
 }
 
 
+/**
+ * @brief Initialization of all the partitions.
+ */
+void
+memSFL_init(void)
+{
+	uint8_t c;
+	
+	for(c = 0; c < MEM_PARTITION_NUM; c++)
+		memSFL_partition_init(mem_partitions[c]);
+}
+
+/**
+ * @brief MIROS SFL allocation by size.
+ *
+ *	The smallest fitting size class is given by the lookup table in constant time.
+ *	If this partition is used up, or the size is larger than all the classes, 
+ *	the allocation is done inside the extended heap.
+ *
+ * \param size	The size to be allocated.
+ * \return		Return the address of the allocated object, NULL if failed.
+ */
+void*
+mem_alloc_sz(uint16_t size)
+{
+	uint8_t c;
+	void *mem;
+	
+	if(size <= MEM_LUT_MAX)
+	{
+		c = pgm_read_byte(&mem_lut[(size + MEM_LUT_GRAIN - 1) / MEM_LUT_GRAIN]);
+		if(c != MEM_NO_CLASS)
+			return mem_alloc(mem_partitions[c]);
+	}
+	
+	mem = memSFL_extHeap_alloc(size);
+	MEM_TRACE_ALLOC(mem, size);
+	return mem;
+}
+
 /**
  * @brief MIROS SFL allocation.
  *
@@ -85,28 +156,41 @@ void*
 mem_alloc(partition_t *pt)
 {
 	memblk_t *mem_blk = NULL;
+	void *mem;
 
+	/* the allocation over the quota of the thread fails at once. */
+	if(MEM_QUOTA_OVER(pt->blk_size + sizeof(memblk_t)))
+	{
+		MEM_STATS_FAIL();
+		mem = NULL;
+	}
+	
 	/* If partition free list is not NULL, allocate from this partition. */
-	if(pt->ptFreeQ != NULL)
+	else if(pt->ptFreeQ != NULL)
 	{
 		/* delete from the header directly, allocation can be completed in constant time. */
 		mem_blk = pt->ptFreeQ;
 		pt->ptFreeQ = pt->ptFreeQ->next;
 		pt->blk_num--;
-		/* return. */
-		return ((void *)mem_blk + sizeof(memblk_t));
+		MEM_STATS_ALLOC(pt->blk_size + sizeof(memblk_t));
+		MEM_QUOTA_ALLOC(mem_blk->owner, pt->blk_size + sizeof(memblk_t));
+		mem = (void *)mem_blk + sizeof(memblk_t);
 	}
 	
 	/* If partition free list is NULL, allocate from the extended heap space. */
 	else
-		return memSFL_extHeap_alloc(pt->blk_size);
+		mem = memSFL_extHeap_alloc(pt->blk_size);
+	
+	/* the block size is recorded, the required size is not known here. */
+	MEM_TRACE_ALLOC(mem, pt->blk_size);
+	return mem;
 }
 
 
 /**
  * @brief Free a chunk
  *
- *	If object to be released is inside the extended heap space, add it into the free list of hpFreeQ.  
+ *	If object to be released is inside the extended heap space, add it into the free list of its size bin in hpFreeQ.  
  *	If two freed objects are adjacent, coalesce them.
  *	If object to be released is inside a partition, add it into the partition free list ptFreeQ.
  *
@@ -118,10 +202,14 @@ mem_free(void *chkMem)
 {
 	memblk_t *mem_blk = NULL;
 	
+	MEM_TRACE_FREE(chkMem);
+	
 	/* if object locates insides a partition, add this object to the header of partition free list. */
-	if(chkMem < heapSaddr)
+	if(chkMem < heapSaddr || chkMem >= (void *)HEAP_EADDR)
 	{
 		mem_blk = (memblk_t *)((void *)chkMem - sizeof(memblk_t));
+		MEM_STATS_FREE(mem_blk->pt->blk_size + sizeof(memblk_t));
+		MEM_QUOTA_FREE(mem_blk->owner, mem_blk->pt->blk_size + sizeof(memblk_t));
 		/* insert into the header of list ptFreeQ. */
 		mem_blk->next = mem_blk->pt->ptFreeQ;
 		mem_blk->pt->ptFreeQ = mem_blk;
@@ -129,9 +217,32 @@ mem_free(void *chkMem)
 		mem_blk->pt->blk_num++;
 	}
 	
-	/* if object locates in the extended heap, add this object to the free list hpFreeQ. */
+	/* if object locates in the extended heap, add this object to the free lists hpFreeQ. */
 	else
 		memSFL_extHeap_free(chkMem);
 }
 
+#if MEM_STATS
+/**
+ * @brief Walk of the free memory for the heap statistics.
+ *	The free blocks of the partitions are added into the free bytes, then the extended heap is walked.
+ *
+ * \param st	Add the free chunks into it by "memStats_chunk".
+ */
+void
+memStats_walk(mem_stats_t *st)
+{
+	uint8_t c;
+	uint16_t sz;
+	
+	for(c = 0; c < MEM_PARTITION_NUM; c++)
+	{
+		sz = (uint16_t)mem_partitions[c]->blk_num * (mem_partitions[c]->blk_size + sizeof(memblk_t));
+		st->freeSz += sz;
+		st->ptFree += sz;
+	}
+	memSFL_extHeap_walk(st);
+}
+#endif
+
 #endif
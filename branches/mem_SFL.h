@@ -30,6 +30,9 @@ typedef struct partition partition_t;
 __ALIGNED2 typedef struct memblk {
 	struct memblk *next;	/* single link list to link all the free blocks. */
 	partition_t *pt;		/* link to the partition header, for block collection when this block is released. */
+	#if MEM_QUOTA
+	thrd_tcb_t *owner;		/* thread charged with this block, if allocated. */
+	#endif
 } memblk_t;
 
 /* header for each partition. */
@@ -65,24 +68,55 @@ __ALIGNED2 struct partition {
  *		The total number of memory blocks in this partition.
  */
 #define MEM_PARTITION_CREATE(name, struct_name, blkNum) \
-	uint8_t CC_CONCAT(name,_blks)[(sizeof(struct_name)+sizeof(memblk_t))*blkNum]; \
+	MEM_PARTITION_CREATE_SZ(name, sizeof(struct_name), blkNum)
+
+/* the same as MEM_PARTITION_CREATE, with the block size given in bytes. */
+#define MEM_PARTITION_CREATE_SZ(name, blkSize, blkNum) \
+	uint8_t CC_CONCAT(name,_blks)[((blkSize)+sizeof(memblk_t))*(blkNum)]; \
 	partition_t CC_CONCAT(name,_pt) = {	\
-		sizeof(struct_name), \
-		blkNum, \
+		(blkSize), \
+		(blkNum), \
 		(void *)CC_CONCAT(name,_blks)}
 
+/*
+ * Partition tables, all the partitions are generated from them.
+ * Each entry is P(name, blkSize, blkNum, a), "P" and "a" are given where the table is used.
+ *
+ * The typed partitions hold the kernel objects, they are only allocated by "mem_alloc" with their partition.
+ * The size classes are the partitions of "mem_alloc_sz", listed in ascending block sizes:
+ * the first one fitting the requested size is taken through a lookup table generated at compile time.
+ * Their block sizes must not be larger than MEM_LUT_MAX.
+ */
+#define MEM_TYPED_PARTITIONS(P, a) \
+	P(timer, sizeof(timer_t), 2, a)		/* software timers. */ \
+	P(ipc, sizeof(ipc_msgQ_t), 2, a)	/* IPC sending/recving. */
+#define MEM_SIZE_CLASSES(P, a) \
+	P(buf16, 16, 4, a)					/* general purpose buffers. */ \
+	P(buf32, 32, 2, a) \
+	P(buf64, 64, 2, a)
+#define MEM_PARTITION_TABLE(P, a)	MEM_TYPED_PARTITIONS(P, a) MEM_SIZE_CLASSES(P, a)
+
+/* The lookup table of "mem_alloc_sz" maps each MEM_LUT_GRAIN bytes of the requested size to a size class,
+   from 0 to MEM_LUT_MAX bytes. The larger requests are done in the extended heap. */
+#define MEM_LUT_GRAIN		4
+#define MEM_LUT_NUM			64
+#define MEM_LUT_MAX			(MEM_LUT_GRAIN * (MEM_LUT_NUM - 1))
+#define MEM_NO_CLASS		0xFF
+
 
 /* === GLOBALS ============================================================= */
-extern uint8_t timer_blks[];
-extern partition_t timer_pt;
-extern uint8_t ipc_blks[];
-extern partition_t ipc_pt;
+#define MEM_PARTITION_EXTERN(name, blkSize, blkNum, a) \
+	extern uint8_t CC_CONCAT(name,_blks)[]; \
+	extern partition_t CC_CONCAT(name,_pt);
+MEM_PARTITION_TABLE(MEM_PARTITION_EXTERN, _)
 
 
 /* === Prototypes =========================================================== */
 /* memory management */
 extern void memSFL_partition_init(partition_t *pt);
+extern void memSFL_init(void);
 extern void* mem_alloc(partition_t *pt);
+extern void* mem_alloc_sz(uint16_t size);
 extern void mem_free(void *chkMem);
 
 
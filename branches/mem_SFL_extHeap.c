@@ -4,6 +4,12 @@
  * @brief	MIROS segregated free list (SFL) allocator.
  *			When a partition is memory overflowed, the allocation will be done in the extended heap.
  *
+ *			The free chunks of the extended heap are kept in a few power-of-two size bins, 
+ *			each of them is a list in the address order. An allocation takes the lowest fitting chunk of its own bin, 
+ *			or the lowest chunk of the next non-empty bin, where all the chunks fit.
+ *			The allocated chunks keep boundary tags in their headers, 
+ *			thus a released chunk is merged with its free neighbours at once, without a walk through the free lists.
+ *
  * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
  * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
  * @author    Supported email: liu@isima.fr
@@ -18,86 +24,238 @@
 #if	MEM_SFL
 #include "mem_SFL.h"
 #include "mem_SFL_extHeap.h"
+#include "mem_stats.h"
+#include "mem_quota.h"
 /* === TYPES =============================================================== */
 
 
 /* === MACROS ============================================================== */
+/* the chunk just above "ck". */
+#define SFL_NEXT_PHYS(ck)	((sfl_extHpHdr_t *)((uintptr_t)(ck) + (ck)->ckSize))
 
 
 /* === GLOBALS ============================================================= */
-/* A list to link all the free memory in the extended heap. */
-sfl_extHpHdr_t *hpFreeQ = NULL;	
+/* Lists to link all the free memory in the extended heap, one for each size bin. */
+sfl_extHpHdr_t *hpFreeQ[SFL_BIN_NUM];
+
+/* ending address of the extended heap. */
+void* sfl_hpEaddr = NULL;
 
 
 /* === PROTOTYPES ========================================================== */
+static uint8_t sfl_bin(uint16_t size);
+static void sfl_insert(sfl_extHpHdr_t *ck);
+static void sfl_remove(sfl_extHpHdr_t *ck);
+static void sfl_replace(sfl_extHpHdr_t *old, sfl_extHpHdr_t *ck);
+static void sfl_resize(sfl_extHpHdr_t *ck, uint16_t size);
+static sfl_extHpHdr_t* sfl_search(uint16_t size);
 
 
 /* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Size bin of a chunk.
+ */
+static uint8_t
+sfl_bin(uint16_t size)
+{
+	uint8_t bin = 0;
+	
+	size >>= SFL_BIN_SHIFT + 1;
+	while(size != 0 && bin < SFL_BIN_NUM - 1)
+	{
+		size >>= 1;
+		bin++;
+	}
+	return bin;
+}
+
+/**
+ * @brief Insert a free chunk into its bin, in the address order.
+ */
+static void
+sfl_insert(sfl_extHpHdr_t *ck)
+{
+	sfl_extHpHdr_t **Qhead = &hpFreeQ[sfl_bin(ck->ckSize)], *pos = *Qhead;
+	
+	/* If the queue is empty. */
+	if(pos == NULL)
+	{
+		*Qhead = ck;
+		ck->prev = ck->next = ck;
+		return;
+	}
+	
+	/* locate the insertion position. */
+	while(pos < ck)	{
+		/* check next until find the available position. */
+		pos = pos->next;
+		/* if comes to the ends, then break, and will insert to the queue tail. */
+		if(pos == *Qhead)	break;
+	}
+	
+	/* insert "ck" in front of "pos", and update the queue head. */
+	dlst_insert((dlist *)ck, (dlist *)pos);
+	if(ck < *Qhead)		*Qhead = ck;
+}
+
+/**
+ * @brief Delete a free chunk from its bin.
+ */
+static void
+sfl_remove(sfl_extHpHdr_t *ck)
+{
+	dlst_del((dlist **)(&hpFreeQ[sfl_bin(ck->ckSize)]), (dlist *)ck);
+}
+
+/**
+ * @brief Put a chunk at the place of a free chunk in its bin, and delete this free chunk.
+ *	The two chunks must be in the same bin, and no other free chunk is between them.
+ */
+static void
+sfl_replace(sfl_extHpHdr_t *old, sfl_extHpHdr_t *ck)
+{
+	uint8_t bin = sfl_bin(old->ckSize);
+	
+	dlst_insert((dlist *)ck, (dlist *)old);
+	if(hpFreeQ[bin] == old)		hpFreeQ[bin] = ck;
+	dlst_del((dlist **)(&hpFreeQ[bin]), (dlist *)old);
+}
+
+/**
+ * @brief Change the size of a free chunk, it is moved to another bin only if its size bin is changed.
+ */
+static void
+sfl_resize(sfl_extHpHdr_t *ck, uint16_t size)
+{
+	if(sfl_bin(size) == sfl_bin(ck->ckSize))
+	{
+		ck->ckSize = size;
+		return;
+	}
+	
+	sfl_remove(ck);
+	ck->ckSize = size;
+	sfl_insert(ck);
+}
+
+/**
+ * @brief Search a free chunk of at least "size" bytes.
+ *	The chunks of its own bin may be smaller, this bin is searched in the address order.
+ *	All the chunks of the larger bins fit, the lowest one of the next non-empty bin is taken.
+ *
+ * \param size	Chunk size.
+ * \return		The free chunk, NULL if not found.
+ */
+static sfl_extHpHdr_t*
+sfl_search(uint16_t size)
+{
+	sfl_extHpHdr_t *ck;
+	uint8_t bin = sfl_bin(size);
+	
+	if((ck = hpFreeQ[bin]) != NULL)
+	{
+		do
+		{
+			if(ck->ckSize >= size)	return ck;
+			ck = ck->next;
+		} while(ck != hpFreeQ[bin]);
+	}
+	
+	for(bin++; bin < SFL_BIN_NUM; bin++)
+		if(hpFreeQ[bin] != NULL)	return hpFreeQ[bin];
+	
+	return NULL;
+}
+
+/**
+ * @brief Initialization of the extended heap.
+ * \param start	Start address of the heap.
+ * \param size	Heap size.
+ *
+ * The heap is one free chunk.
+ */
+void
+memSFL_extHeap_init(void *start, uint16_t size)
+{
+	sfl_extHpHdr_t *ck = (sfl_extHpHdr_t *)start;
+	uint8_t bin;
+	
+	for(bin = 0; bin < SFL_BIN_NUM; bin++)
+		hpFreeQ[bin] = NULL;
+	
+	sfl_hpEaddr = (void *)((uintptr_t)start + size);
+	ck->ckSize = size;
+	sfl_insert(ck);
+}
+
 /**
  * @brief MIROS SFL allocation in the extended heap space.
  *
  *	If SFL allocation from a given partition is failed, this allocation will be done continuously inside the extended heap. 
- *	In the extended heap, the SF allocation mechanism will be used. 
+ *	In the extended heap, the SF allocation mechanism will be used, from the size bins. 
  *
  * \param objSz	The size to be allocated from the extended heap.
  * \return			Return the address of the allocated object.
  */
 void*
-memSFL_extHeap_alloc(uint8_t objSz)
+memSFL_extHeap_alloc(uint16_t objSz)
 {
-	sfl_extHpHdr_t *ck, *alloc = NULL;
-	uint8_t splitSz = 0;
+	sfl_extHpHdr_t *ck, *alloc, *nx;
+	uint16_t splitSz = 0;
 	
 	/* Compute the required length. In extended heap space, the header is required for each object. */
 	objSz = ALIGN(objSz+sizeof(sfl_extHpHdr_t), ALIGN_SIZE);
 	/* get the split size. If the free chunk size is larger then this, split it. */
 	splitSz = objSz+sizeof(sfl_extHpHdr_t)+MIN_PAYLOAD_SIZE;
 	
-	/* no available memory left. */
-	if(hpFreeQ == NULL)	return NULL;
-
-	/* start allocation from the queue tail. */
-	ck = hpFreeQ;
-	/* search from the freed chunk queue. */
-	do
+	/* no available memory left, or the allocation is over the quota of the thread. */
+	if(MEM_QUOTA_OVER(objSz) || (ck = sfl_search(objSz)) == NULL)
 	{
-		/* find an available entry. */
-		if((ck->ckSize >= objSz) && (ck->ckSize <= splitSz))
-		{
-			/* initialization and return. The total size "splitSz" will be allocated. */
-			ck->ckSize = splitSz;	
-			/* delete ck from the freed chunk queue. */
-			dlst_del((dlist **)(&hpFreeQ), (dlist *)ck);
-			/* reference not used, return the data payload address directly. */
-			return (void *)((uint16_t)ck + sizeof(sfl_extHpHdr_t));
-		}
-		
-		/* split operation is required as the chunk size 
-		   is larger than the required one. */
-		if(ck->ckSize > splitSz)
-		{
-			/* split a piece from the bottom of this chunk. */
-			alloc = (sfl_extHpHdr_t *)((uint16_t)ck + ck->ckSize - objSz);
-			alloc->ckSize = objSz;
-			/* new chunk update. */
-			ck->ckSize -= objSz;
-			/* reference not used, return the data payload address directly. */
-			return (void *)((uint16_t)alloc + sizeof(sfl_extHpHdr_t));
-		}
-		
-		/* check the next one */
-		ck = ck->next;
-	} while(ck != hpFreeQ);
+		MEM_STATS_FAIL();
+		return NULL;
+	}
+	/* the whole chunk is taken if it is too small to be split, and its size is charged. */
+	if(ck->ckSize <= splitSz && MEM_QUOTA_OVER(ck->ckSize))
+	{
+		MEM_STATS_FAIL();
+		return NULL;
+	}
+	nx = SFL_NEXT_PHYS(ck);
 	
-	/* not successful. */
-	return NULL;
+	if(ck->ckSize <= splitSz)
+	{
+		/* too small to be split, the whole chunk is allocated and "ckSize" is kept. */
+		/* delete ck from the freed chunk queue. */
+		sfl_remove(ck);
+		alloc = ck;
+		/* the chunk below a free chunk is allocated, otherwise they would have been merged. */
+		alloc->prev = NULL;
+	}
+	else
+	{
+		/* split a piece from the bottom of this chunk. */
+		alloc = (sfl_extHpHdr_t *)((uintptr_t)ck + ck->ckSize - objSz);
+		alloc->prev = ck;
+		/* new chunk update, it keeps its place in the address order. */
+		sfl_resize(ck, ck->ckSize - objSz);
+		alloc->ckSize = objSz;
+	}
+	
+	/* boundary tags: this chunk is allocated, and the chunk above is not above a free chunk any more. */
+	alloc->next = NULL;
+	if(nx != sfl_hpEaddr)	nx->prev = NULL;
+	MEM_STATS_ALLOC(alloc->ckSize);
+	MEM_QUOTA_ALLOC(alloc->owner, alloc->ckSize);
+	
+	/* reference not used, return the data payload address directly. */
+	return (void *)((uintptr_t)alloc + sizeof(sfl_extHpHdr_t));
 }
 
 /**
  * @brief Free a chunk
  *
- *	If object to be released is inside the extended heap space, then add it into the free list of extHeapFreeQ. 
- *	In this case, if two freed objects are adjacent, coalesce them.
+ *	If object to be released is inside the extended heap space, then add it into the free list of its size bin. 
+ *	The free neighbours are found by the boundary tags, and are merged with it at once.
  *	Otherwise, add it into the partition free list ptFreeQ. In this case, no memory coalescence will be required.
  *
  * \param mem  Address of the object to be released.
@@ -106,35 +264,67 @@ memSFL_extHeap_alloc(uint8_t objSz)
 void
 memSFL_extHeap_free(void *mem)
 {
-	sfl_extHpHdr_t *chuk, *ck = hpFreeQ;
+	sfl_extHpHdr_t *chuk, *nx, *pv;
+	uint16_t size;
 	/* locate to the chunk header position. */
 	chuk = mem - sizeof(sfl_extHpHdr_t);
-
-	/* If the queue is empty. */
-	if(hpFreeQ == NULL)  {
-		hpFreeQ = chuk;
-		hpFreeQ->prev = hpFreeQ->next = hpFreeQ;
-		return;
+	MEM_STATS_FREE(chuk->ckSize);
+	MEM_QUOTA_FREE(chuk->owner, chuk->ckSize);
+	
+	size = chuk->ckSize;
+	pv = chuk->prev;
+	nx = SFL_NEXT_PHYS(chuk);
+	
+	/* lower-address merging, into the free chunk below. */
+	if(pv != NULL)
+	{
+		/* upper-address merging as well, the chunk above is free if it is linked. */
+		if(nx != sfl_hpEaddr && nx->next != NULL)
+		{
+			sfl_remove(nx);
+			size += nx->ckSize;
+		}
+		sfl_resize(pv, pv->ckSize + size);
+		chuk = pv;
 	}
 	
-	/* locate the insertion position. */
-	while(ck < chuk)	{
-		/* check next until find the available position. */
-		ck = ck->next;
-		/* if comes to the ends, then break, and will insert to the queue tail. */
-		if(ck == hpFreeQ)	break;
+	/* upper-address merging only, "chuk" takes the place of "nx" in the address order. */
+	else if(nx != sfl_hpEaddr && nx->next != NULL)
+	{
+		sfl_replace(nx, chuk);
+		chuk->ckSize = nx->ckSize;
+		sfl_resize(chuk, chuk->ckSize + size);
 	}
 	
-	/* insert "chuk" in front of "ck". */
-	dlst_insert((dlist *)chuk, (dlist *)ck);
-	/* update the queue	head. */
-	if(chuk < hpFreeQ)		hpFreeQ =  chuk;
+	/* no free neighbour. */
+	else
+		sfl_insert(chuk);
 	
-	/* merge if two free chunks are adjacent.
-	   firstly, upper-address merging, merge "chuk & chuk->next".
-	   later, lower-address merging, merge "chuk->prev & chuk". */
-	dlst_merge((dlist **)(&hpFreeQ), (dlist *)chuk, (dlist *)chuk->next);
-	dlst_merge((dlist **)(&hpFreeQ), (dlist *)chuk->prev, (dlist *)chuk);
+	/* boundary tag of the chunk above. */
+	nx = SFL_NEXT_PHYS(chuk);
+	if(nx != sfl_hpEaddr)	nx->prev = chuk;
 }
 
+#if MEM_STATS
+/**
+ * @brief Walk of the extended heap for the heap statistics, called by "memStats_walk" of the SFL allocator.
+ * \param st	Add the free chunks into it by "memStats_chunk".
+ */
+void
+memSFL_extHeap_walk(mem_stats_t *st)
+{
+	sfl_extHpHdr_t *ck;
+	uint8_t bin;
+	
+	for(bin = 0; bin < SFL_BIN_NUM; bin++)
+	{
+		if((ck = hpFreeQ[bin]) == NULL)	continue;
+		do {
+			if(memStats_chunk(st, ck->ckSize))	return;
+			ck = ck->next;
+		} while(ck != hpFreeQ[bin]);
+	}
+}
+#endif
+
 #endif
@@ -16,31 +16,49 @@
 #include "board.h"
 #include "evt_driven_sched.h"
 #include "qlist_proc.h"
+#include "mem_stats.h"
 
 #if	MEM_SFL
 /* === Macros =============================================================== */
 /* the minimum size of a new split chunk should be larger than MIN_PAYLOAD_SIZE. */
 #define MIN_PAYLOAD_SIZE	8
 
+/* The free chunks are kept in SFL_BIN_NUM size bins, by powers of two: 
+   bin 0 holds the chunks smaller than 2^(SFL_BIN_SHIFT+1) bytes, bin i the chunks in [2^(SFL_BIN_SHIFT+i), 2^(SFL_BIN_SHIFT+i+1)), 
+   and the last bin all the larger ones. */
+#define SFL_BIN_SHIFT		4
+#define SFL_BIN_NUM			6
+
 
 /* === Types ================================================================ */
+/* In a free chunk, "prev" and "next" link the free chunks of its bin.
+   In an allocated chunk, they are the boundary tags: "next" is NULL, 
+   and "prev" is the free chunk just below it, NULL if the chunk below is allocated. */
 typedef __ALIGNED2 struct sfl_extHeapHdr
 {
 	struct sfl_extHeapHdr *prev;		/* to previous free chunk */
 	struct sfl_extHeapHdr *next;		/* to next free chunk */
 	uint16_t ckSize;					/* size of chunk, including the chuk_hdr */
+	#if MEM_QUOTA
+	thrd_tcb_t *owner;					/* thread charged with this chunk. */
+	#endif
 } sfl_extHpHdr_t;
 
 
 /* === GLOBALS ============================================================= */
-extern sfl_extHpHdr_t *hpFreeQ;
+extern sfl_extHpHdr_t *hpFreeQ[SFL_BIN_NUM];
+extern void* sfl_hpEaddr;
 extern void* heapSaddr;
 
 
 /* === Prototypes =========================================================== */
 /* memory management */
-extern void* memSFL_extHeap_alloc(uint8_t objSz);
+extern void memSFL_extHeap_init(void *start, uint16_t size);
+extern void* memSFL_extHeap_alloc(uint16_t objSz);
 extern void memSFL_extHeap_free(void *mem);
+#if MEM_STATS
+extern void memSFL_extHeap_walk(mem_stats_t *st);
+#endif
 
 #endif
 #endif
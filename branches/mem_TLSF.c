@@ -0,0 +1,341 @@
+/**
+ * @file mem_TLSF.c
+ *
+ * @brief  MIROS two-level segregated fit (TLSF) allocator.
+ *			The free blocks are kept in segregated lists: the first level splits the sizes by powers of two, 
+ *			and the second level splits each power of two into TLSF_SL_NUM linear ranges.
+ *			Two levels of bitmaps tell the non-empty lists, thus a fitting free block is found 
+ *			by a few bit operations instead of a walk through the free list.
+ *			The released blocks are merged with their free physical neighbours at once, 
+ *			using the "prevPhys" link and the flags kept in the block headers.
+ *
+ *			Both allocation and release are done in bounded time whatever the fragmentation, 
+ *			so they can be used from the RT threads and accounted in the schedulability analysis.
+ *			The same as the SFL allocator, no reference is used: the allocated blocks are never moved.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include "typedef.h"
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+
+#if MEM_TLSF
+#include "mem_TLSF.h"
+#include "mem_trace.h"
+#include "mem_stats.h"
+#include "mem_quota.h"
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+/* header size of an allocated block, the payload starts just after it. */
+#define TLSF_HDR_SIZE		ALIGN(offsetof(tlsf_blk_t, nextFree), TLSF_ALIGN)
+/* minimum block size, a free block must hold its links. */
+#define TLSF_MIN_BLK		ALIGN(sizeof(tlsf_blk_t), TLSF_ALIGN)
+
+#define TLSF_SIZE(b)		((b)->size & ~TLSF_FLAGS)
+#define TLSF_NEXT_PHYS(b)	((tlsf_blk_t *)((uint8_t *)(b) + TLSF_SIZE(b)))
+
+
+/* === GLOBALS ============================================================= */
+/* non-empty first-level classes, and non-empty second-level lists of each class. */
+uint16_t tlsf_flBitmap;
+uint8_t tlsf_slBitmap[TLSF_FL_NUM];
+/* heads of the free lists. */
+tlsf_blk_t *tlsf_freeQ[TLSF_FL_NUM][TLSF_SL_NUM];
+
+
+/* === PROTOTYPES ========================================================== */
+static uint8_t tlsf_fls(uint16_t x);
+static void tlsf_mapping(uint16_t size, uint8_t *fl, uint8_t *sl);
+static void tlsf_insert(tlsf_blk_t *blk);
+static void tlsf_remove(tlsf_blk_t *blk);
+static tlsf_blk_t* tlsf_search(uint16_t size);
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Index of the most significant set bit.
+ * \param x		Non-zero value.
+ *
+ * There is no such instruction on AVR, 4 steps are always done.
+ */
+static uint8_t
+tlsf_fls(uint16_t x)
+{
+	uint8_t b = 0;
+	
+	if(x & 0xFF00)	{ b += 8; x >>= 8; }
+	if(x & 0xF0)	{ b += 4; x >>= 4; }
+	if(x & 0x0C)	{ b += 2; x >>= 2; }
+	if(x & 0x02)	{ b += 1; }
+	
+	return b;
+}
+
+/**
+ * @brief Get the free list of a block size.
+ * \param size	Block size.
+ * \param fl	Return the first-level index.
+ * \param sl	Return the second-level index.
+ */
+static void
+tlsf_mapping(uint16_t size, uint8_t *fl, uint8_t *sl)
+{
+	uint8_t b;
+	
+	if(size < TLSF_SMALL)
+	{
+		*fl = 0;
+		*sl = size >> TLSF_ALIGN_LOG2;
+		return;
+	}
+	
+	b = tlsf_fls(size);
+	*fl = b - TLSF_FL_SHIFT + 1;
+	*sl = (size >> (b - TLSF_SL_LOG2)) & (TLSF_SL_NUM - 1);
+}
+
+/**
+ * @brief Insert a free block into its free list.
+ * \param blk	The free block.
+ */
+static void
+tlsf_insert(tlsf_blk_t *blk)
+{
+	uint8_t fl, sl;
+	
+	tlsf_mapping(TLSF_SIZE(blk), &fl, &sl);
+	
+	blk->prevFree = NULL;
+	blk->nextFree = tlsf_freeQ[fl][sl];
+	if(blk->nextFree != NULL)
+		blk->nextFree->prevFree = blk;
+	tlsf_freeQ[fl][sl] = blk;
+	
+	tlsf_flBitmap |= (1 << fl);
+	tlsf_slBitmap[fl] |= (1 << sl);
+}
+
+/**
+ * @brief Delete a free block from its free list.
+ * \param blk	The free block.
+ */
+static void
+tlsf_remove(tlsf_blk_t *blk)
+{
+	uint8_t fl, sl;
+	
+	tlsf_mapping(TLSF_SIZE(blk), &fl, &sl);
+	
+	if(blk->nextFree != NULL)
+		blk->nextFree->prevFree = blk->prevFree;
+	if(blk->prevFree != NULL)
+		blk->prevFree->nextFree = blk->nextFree;
+	else
+	{
+		tlsf_freeQ[fl][sl] = blk->nextFree;
+		/* the list becomes empty. */
+		if(blk->nextFree == NULL)
+		{
+			tlsf_slBitmap[fl] &= ~(1 << sl);
+			if(tlsf_slBitmap[fl] == 0)
+				tlsf_flBitmap &= ~(1 << fl);
+		}
+	}
+}
+
+/**
+ * @brief Find a free block not smaller than a size.
+ * \param size	Required block size.
+ * \return		The head of the first non-empty list, whose blocks are all large enough, NULL if none.
+ *
+ * The size is rounded up to the next list, thus any block of the found list fits without a walk.
+ */
+static tlsf_blk_t*
+tlsf_search(uint16_t size)
+{
+	uint16_t flMap;
+	uint8_t fl, sl, slMap;
+	
+	if(size >= TLSF_SMALL)
+		size += (1 << (tlsf_fls(size) - TLSF_SL_LOG2)) - 1;
+	tlsf_mapping(size, &fl, &sl);
+	if(fl >= TLSF_FL_NUM)	return NULL;
+	
+	/* a list in the same first-level class, or the smallest one of a larger class. */
+	slMap = tlsf_slBitmap[fl] & (uint8_t)(0xFF << sl);
+	if(slMap == 0)
+	{
+		flMap = tlsf_flBitmap & (uint16_t)(0xFFFF << (fl + 1));
+		if(flMap == 0)	return NULL;
+		fl = tlsf_fls(flMap & -flMap);
+		slMap = tlsf_slBitmap[fl];
+	}
+	sl = tlsf_fls(slMap & -slMap);
+	
+	return tlsf_freeQ[fl][sl];
+}
+
+/**
+ * @brief Initialization of the TLSF heap.
+ * \param start	Start address of the heap.
+ * \param size	Heap size, the part beyond 2^(TLSF_MAX_LOG2+1) bytes is not used.
+ *
+ * The heap is one free block, followed by an allocated sentinel header
+ * which stops the merging at the heap end.
+ */
+void
+memTLSF_init(void *start, uint16_t size)
+{
+	tlsf_blk_t *blk, *sentinel;
+	uint8_t fl, sl;
+	
+	tlsf_flBitmap = 0;
+	for(fl = 0; fl < TLSF_FL_NUM; fl++)
+	{
+		tlsf_slBitmap[fl] = 0;
+		for(sl = 0; sl < TLSF_SL_NUM; sl++)
+			tlsf_freeQ[fl][sl] = NULL;
+	}
+	
+	/* align the heap bounds. */
+	blk = (tlsf_blk_t *)ALIGN((uintptr_t)start, TLSF_ALIGN);
+	size -= (uint8_t *)blk - (uint8_t *)start;
+	if(size > (uint16_t)((2u << TLSF_MAX_LOG2) - TLSF_ALIGN))
+		size = (2u << TLSF_MAX_LOG2) - TLSF_ALIGN;
+	size &= ~(TLSF_ALIGN - 1);
+	if(size < TLSF_MIN_BLK + TLSF_HDR_SIZE)	return;
+	
+	blk->prevPhys = NULL;
+	blk->size = (size - TLSF_HDR_SIZE) | TLSF_FREE;
+	tlsf_insert(blk);
+	
+	sentinel = TLSF_NEXT_PHYS(blk);
+	sentinel->prevPhys = blk;
+	sentinel->size = TLSF_PREV_FREE;
+}
+
+/**
+ * @brief Memory allocated by MIROS TLSF allocator.
+ *			The found free block is split if the remaining part can make a block.
+ *
+ * \param objSz		Required size to be allocated.
+ * \return			Address of the allocated payload, NULL if failed.
+ */
+void*
+mem_alloc(uint16_t objSz)
+{
+	tlsf_blk_t *blk, *rest;
+	uint16_t size, remain = 0;
+	
+	/* Compute the required length. */
+	size = ALIGN(objSz + TLSF_HDR_SIZE, TLSF_ALIGN);
+	if(size < TLSF_MIN_BLK)
+		size = TLSF_MIN_BLK;
+	/* the allocation over the quota of the thread fails at once. */
+	blk = (size < objSz || size >= (2u << TLSF_MAX_LOG2) || MEM_QUOTA_OVER(size)) ? NULL : tlsf_search(size);
+	/* the whole block is taken if it is too small to be split, and its size is charged. */
+	if(blk != NULL)
+	{
+		remain = TLSF_SIZE(blk) - size;
+		if(remain < TLSF_MIN_BLK && MEM_QUOTA_OVER(TLSF_SIZE(blk)))
+			blk = NULL;
+	}
+	if(blk == NULL)
+	{
+		MEM_TRACE_ALLOC(NULL, objSz);
+		MEM_STATS_FAIL();
+		return NULL;
+	}
+	tlsf_remove(blk);
+	
+	/* split the tail off, and give it back to the free lists. */
+	if(remain >= TLSF_MIN_BLK)
+	{
+		rest = (tlsf_blk_t *)((uint8_t *)blk + size);
+		rest->prevPhys = blk;
+		rest->size = remain | TLSF_FREE;
+		TLSF_NEXT_PHYS(rest)->prevPhys = rest;
+		blk->size = size | (blk->size & TLSF_FLAGS);
+		tlsf_insert(rest);
+	}
+	else
+		TLSF_NEXT_PHYS(blk)->size &= ~TLSF_PREV_FREE;
+	
+	blk->size &= ~TLSF_FREE;
+	MEM_STATS_ALLOC(TLSF_SIZE(blk));
+	MEM_QUOTA_ALLOC(blk->owner, TLSF_SIZE(blk));
+	
+	MEM_TRACE_ALLOC((uint8_t *)blk + TLSF_HDR_SIZE, objSz);
+	return (uint8_t *)blk + TLSF_HDR_SIZE;
+}
+
+/**
+ * @brief Free a chunk.
+ *			The block is merged with its free physical neighbours at once.
+ *
+ * \param mem  Address of the payload to be released.
+ */
+void
+mem_free(void *mem)
+{
+	tlsf_blk_t *blk, *nb;
+	
+	if(mem == NULL)	return;
+	MEM_TRACE_FREE(mem);
+	blk = (tlsf_blk_t *)((uint8_t *)mem - TLSF_HDR_SIZE);
+	MEM_STATS_FREE(TLSF_SIZE(blk));
+	MEM_QUOTA_FREE(blk->owner, TLSF_SIZE(blk));
+	
+	/* merge with the previous block. */
+	if(blk->size & TLSF_PREV_FREE)
+	{
+		nb = blk->prevPhys;
+		tlsf_remove(nb);
+		nb->size += TLSF_SIZE(blk);
+		blk = nb;
+	}
+	
+	/* merge with the next block. */
+	nb = TLSF_NEXT_PHYS(blk);
+	if(nb->size & TLSF_FREE)
+	{
+		tlsf_remove(nb);
+		blk->size += TLSF_SIZE(nb);
+	}
+	
+	blk->size |= TLSF_FREE;
+	nb = TLSF_NEXT_PHYS(blk);
+	nb->prevPhys = blk;
+	nb->size |= TLSF_PREV_FREE;
+	tlsf_insert(blk);
+}
+
+#if MEM_STATS
+/**
+ * @brief Walk of the free memory for the heap statistics.
+ * \param st	Add the free chunks into it by "memStats_chunk".
+ */
+void
+memStats_walk(mem_stats_t *st)
+{
+	tlsf_blk_t *blk;
+	uint8_t fl, sl;
+	
+	for(fl = 0; fl < TLSF_FL_NUM; fl++)
+	{
+		if((tlsf_flBitmap & (1 << fl)) == 0)	continue;
+		for(sl = 0; sl < TLSF_SL_NUM; sl++)
+			for(blk = tlsf_freeQ[fl][sl]; blk != NULL; blk = blk->nextFree)
+				if(memStats_chunk(st, TLSF_SIZE(blk)))	return;
+	}
+}
+#endif
+
+#endif
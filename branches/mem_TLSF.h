@@ -0,0 +1,65 @@
+/**
+ * @file mem_TLSF.h
+ *
+ * @brief  header for mem_TLSF.c
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _MEM_TLSF_H_
+#define _MEM_TLSF_H_ 
+ 
+/* === Includes ============================================================= */
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+
+#if	MEM_TLSF
+/* === Macros =============================================================== */
+/* Block sizes are multiples of TLSF_ALIGN, the two low bits of the size field are used as flags. */
+#define TLSF_ALIGN_LOG2		2
+#define TLSF_ALIGN			(1 << TLSF_ALIGN_LOG2)
+/* Each first-level class [2^n, 2^(n+1)) is split into 2^TLSF_SL_LOG2 second-level lists. */
+#define TLSF_SL_LOG2		2
+#define TLSF_SL_NUM			(1 << TLSF_SL_LOG2)
+/* Blocks smaller than TLSF_SMALL are kept in the first-level class 0, TLSF_ALIGN bytes per list. */
+#define TLSF_FL_SHIFT		(TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL			(1 << TLSF_FL_SHIFT)
+/* Largest block is smaller than 2^(TLSF_MAX_LOG2+1) bytes, 16 KB covers the whole AVR data memory. */
+#define TLSF_MAX_LOG2		13
+#define TLSF_FL_NUM			(TLSF_MAX_LOG2 - TLSF_FL_SHIFT + 2)
+
+/* block flags in the low bits of "size". */
+#define TLSF_FREE			0x01
+#define TLSF_PREV_FREE		0x02
+#define TLSF_FLAGS			(TLSF_FREE | TLSF_PREV_FREE)
+
+
+/* === Types ================================================================ */
+/* Block header. "nextFree" and "prevFree" are only used by the free blocks, 
+   and are inside the payload of the allocated blocks. */
+typedef __ALIGNED2 struct tlsf_blk
+{
+	struct tlsf_blk *prevPhys;	/* physically previous block, valid if TLSF_PREV_FREE is set. */
+	uint16_t size;				/* whole block size including the header, with the flags. */
+	#if MEM_QUOTA
+	thrd_tcb_t *owner;			/* thread charged with this block, if allocated. */
+	#endif
+	struct tlsf_blk *nextFree;
+	struct tlsf_blk *prevFree;
+} tlsf_blk_t;
+
+
+/* === GLOBALS ============================================================= */
+
+
+/* === Prototypes =========================================================== */
+extern void memTLSF_init(void *start, uint16_t size);
+extern void* mem_alloc(uint16_t objSz);
+extern void mem_free(void *mem);
+
+#endif
+#endif
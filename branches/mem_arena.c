@@ -0,0 +1,196 @@
+/**
+ * @file mem_arena.c
+ *
+ * @brief  Arena allocator for the objects living for one task invocation.
+ *			A region is borrowed from the heap by "arena_begin", the objects are allocated in it by a bump pointer,
+ *			and all of them are released at once by "arena_reset" or "arena_end".
+ *			No header is kept for the objects, and they never fragment the heap.
+ *
+ *			With the SF allocators, the region is accessed by its address, thus it is carved from the heap end,
+ *			out of the chunks moved by the fragment assembling and the compaction, the same as a reference table.
+ *			It is given back to the heap end by "arena_end", and no reference table can be carved while an arena is open.
+ *			An arena ended out of order, e.g. by a thread preempted by another one using an arena, 
+ *			keeps its region until the regions under it are given back.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include "typedef.h"
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+#include "mem_arena.h"
+#include "mem_SFL.h"
+#include "mem_reactive_SF.h"
+#include "mem_proactive_SF.h"
+#include "mem_TLSF.h"
+#include "mem_stats.h"
+#include "mem_quota.h"
+
+#if MEM_ARENA
+/* === TYPES =============================================================== */
+#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+/* ended region waiting to be given back, kept in the region itself. */
+typedef struct mem_arena_defer
+{
+	struct mem_arena_defer *next;
+	uint16_t size;
+	#if MEM_QUOTA
+	thrd_tcb_t *owner;
+	#endif
+} mem_arena_defer_t;
+#endif
+
+
+/* === MACROS ============================================================== */
+
+
+/* === GLOBALS ============================================================= */
+#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+/* number of the regions not given back, the reference tables cannot be carved if not 0. */
+uint8_t memArena_open = 0;
+/* ended regions not at the heap end yet. */
+static mem_arena_defer_t *memArena_deferQ = NULL;
+#endif
+
+
+/* === PROTOTYPES ========================================================== */
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Borrow a region from the heap for an arena.
+ * \param arena	The arena.
+ * \param size	Size of the region.
+ * \return		0 if succeeded, 1 if there is no enough memory.
+ */
+uint8_t
+arena_begin(mem_arena_t *arena, uint16_t size)
+{
+	#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+	HAS_CRITICAL_SECTION;
+
+	size = ALIGN(size, ALIGN_SIZE);
+	/* the region keeps its own record once ended. */
+	if(size < sizeof(mem_arena_defer_t))
+		size = sizeof(mem_arena_defer_t);
+	if(MEM_QUOTA_OVER(size))
+	{
+		MEM_STATS_FAIL();
+		return 1;
+	}
+
+	/* counted before the carving, no reference table can be carved under the region meanwhile. */
+	ENTER_CRITICAL_SECTION;
+	memArena_open++;
+	LEAVE_CRITICAL_SECTION;
+	if((arena->base = memArena_carve(&size)) == NULL)
+	{
+		ENTER_CRITICAL_SECTION;
+		memArena_open--;
+		LEAVE_CRITICAL_SECTION;
+		MEM_STATS_FAIL();
+		return 1;
+	}
+	arena->blk = NULL;
+	MEM_STATS_ALLOC(size);
+	MEM_QUOTA_ALLOC(arena->owner, size);
+	#else
+	#if MEM_SFL
+	arena->blk = mem_alloc_sz(size);
+	#else
+	arena->blk = mem_alloc(size);
+	#endif
+	if(arena->blk == NULL)	return 1;
+	arena->base = (uint8_t *)arena->blk;
+	#endif
+
+	arena->size = size;
+	arena->top = 0;
+	return 0;
+}
+
+/**
+ * @brief Allocation from an arena.
+ * \param arena	The arena.
+ * \param size	Required size.
+ * \return		Address of the allocated object, NULL if the arena is used up.
+ */
+void*
+arena_alloc(mem_arena_t *arena, uint16_t size)
+{
+	void *obj;
+
+	size = ALIGN(size, ALIGN_SIZE);
+	if(size > arena->size - arena->top)		return NULL;
+
+	obj = arena->base + arena->top;
+	arena->top += size;
+	return obj;
+}
+
+/**
+ * @brief Release all the objects of an arena, the region is kept for the new allocations.
+ * \param arena	The arena.
+ */
+void
+arena_reset(mem_arena_t *arena)
+{
+	arena->top = 0;
+}
+
+/**
+ * @brief Give the region of an arena back to the heap.
+ *	With the SF allocators, a region can only be given back at the heap end. 
+ *	If an arena begun later is still open, the region is kept until that one is ended.
+ *
+ * \param arena	The arena, it can be reused at once.
+ */
+void
+arena_end(mem_arena_t *arena)
+{
+	#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+	HAS_CRITICAL_SECTION;
+	mem_arena_defer_t *d, rec, **prev;
+
+	/* the objects are not used any more, the record is written over them. */
+	d = (mem_arena_defer_t *)arena->base;
+	d->size = arena->size;
+	#if MEM_QUOTA
+	d->owner = arena->owner;
+	#endif
+
+	ENTER_CRITICAL_SECTION;
+	d->next = memArena_deferQ;
+	memArena_deferQ = d;
+	/* give back the ended regions at the heap end, until none of them is. */
+	prev = &memArena_deferQ;
+	while((d = *prev) != NULL)
+	{
+		/* the record is overwritten once the region is given back. */
+		rec = *d;
+		if(memArena_uncarve(d, rec.size) != 0)
+		{
+			prev = &d->next;
+			continue;
+		}
+		*prev = rec.next;
+		memArena_open--;
+		MEM_STATS_FREE(rec.size);
+		MEM_QUOTA_FREE(rec.owner, rec.size);
+		/* the heap end has moved up, the regions above may be given back now. */
+		prev = &memArena_deferQ;
+	}
+	LEAVE_CRITICAL_SECTION;
+	#else
+	mem_free(arena->blk);
+	#endif
+
+	arena->blk = NULL;
+	arena->size = arena->top = 0;
+}
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file mem_arena.h
+ *
+ * @brief  header for mem_arena.c
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _MEM_ARENA_H_
+#define _MEM_ARENA_H_
+
+/* === Includes ============================================================= */
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+
+
+/* === Macros =============================================================== */
+/* With the SF allocators, the region of an open arena is at the heap end. 
+   No reference table can be carved under it, otherwise the region could not be given back. */
+#if MEM_ARENA && (MEM_REACTIVE_SF || MEM_PROACTIVE_SF)
+#define MEM_ARENA_OPEN()	(memArena_open != 0)
+#else
+#define MEM_ARENA_OPEN()	0
+#endif
+
+
+/* === Types ================================================================ */
+#if MEM_ARENA
+/* region borrowed from the heap, allocated by a bump pointer. */
+typedef struct mem_arena
+{
+	void *blk;			/* returned by "mem_alloc", not used by the SF allocators. */
+	uint8_t *base;		/* starting address of the region. */
+	uint16_t size;		/* size of the region. */
+	uint16_t top;		/* allocated bytes of the region. */
+	#if MEM_QUOTA
+	thrd_tcb_t *owner;	/* thread charged with the region, for the SF allocators. */
+	#endif
+} mem_arena_t;
+#endif
+
+
+/* === GLOBALS ============================================================= */
+#if MEM_ARENA && (MEM_REACTIVE_SF || MEM_PROACTIVE_SF)
+extern uint8_t memArena_open;
+#endif
+
+
+/* === Prototypes =========================================================== */
+#if MEM_ARENA
+extern uint8_t arena_begin(mem_arena_t *arena, uint16_t size);
+extern void* arena_alloc(mem_arena_t *arena, uint16_t size);
+extern void arena_reset(mem_arena_t *arena);
+extern void arena_end(mem_arena_t *arena);
+#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+/* region at the heap end, provided by the SF allocator. */
+extern void* memArena_carve(uint16_t *size);
+extern uint8_t memArena_uncarve(void *region, uint16_t size);
+#endif
+#endif
+
+#endif
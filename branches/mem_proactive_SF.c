@@ -9,6 +9,10 @@
  *			The memory fragments are assembled once they are appeared in the proactive fragment assembling. 
  *			By this way, the fragments can be prevented to occur, 
  *			and the new allocation can be performed immediately with constant allocation time.
+ *
+ *			If PROSF_DEFER_FREE is set, a released chunk is only marked as dead. 
+ *			The dead chunks are removed together by the compaction, done in steps in the idle loop, 
+ *			or at once when an allocation is failed. Each live chunk is then moved only once for a burst of releases.
  * 
  * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
  * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
@@ -23,6 +27,10 @@
 
 #if MEM_PROACTIVE_SF
 #include "mem_proactive_SF.h"
+#include "mem_trace.h"
+#include "mem_stats.h"
+#include "mem_arena.h"
+#include "mem_quota.h"
 /* === TYPES =============================================================== */
 
 
@@ -30,13 +38,21 @@
 
 
 /* === GLOBALS ============================================================= */
-/* references for the allocated chunks. */
-uint16_t* proSF_Ref[REF_NUM];	
-
 /* starting address of left heap. */
 void* leftHpSaddr;	
 
+/* ending address of the heap, the reference tables carved from the heap are above it. */
+void* proSF_hpEaddr;
+
+#if PROSF_DEFER_FREE
+/* the lowest dead chunk, the compaction starts from it. */
+proSF_chk_hdr_t* proSF_deadQ = NULL;
+#endif
+
 /* === PROTOTYPES ========================================================== */
+#if MEM_REF_GROW || MEM_ARENA
+static void* heap_carve(uint16_t size, uint8_t table);
+#endif
 
 
 /* === IMPLEMENTATION ====================================================== */
@@ -54,29 +70,48 @@ uint16_t*
 mem_alloc(uint8_t reqSize)
 {
 	proSF_chk_hdr_t* chk_alloc = NULL;
-	uint8_t chkSize = reqSize + sizeof(proSF_chk_hdr_t);
-	uint8_t id;
+	uint16_t chkSize = ALIGN(reqSize + sizeof(proSF_chk_hdr_t), ALIGN_SIZE);
+	uint16_t *ref;
+	
+	/* allocate a reference for this chunk.
+	   Firstly, as a reference table may be carved from the heap. 
+	   The allocation over the quota of the thread fails at once. */
+	if(MEM_QUOTA_OVER(chkSize) || (ref = memRef_get()) == NULL)
+	{
+		MEM_TRACE_ALLOC(NULL, reqSize);
+		MEM_STATS_FAIL();
+		return NULL;
+	}
+	
+	#if PROSF_DEFER_FREE
+	/* remove the dead chunks if there is no enough memory left. */
+	if((uintptr_t)leftHpSaddr + chkSize > (uintptr_t)proSF_hpEaddr)
+		mem_compact();
+	#endif
 	
 	/* Check if we have enough memory left for this allocation. */
-	if((uint16_t)((uint16_t)leftHpSaddr+chkSize) > HEAP_EADDR)	return NULL;
-
-	/* allocate a reference for this chunk. */
-	for(id = 0; id < REF_NUM; id++)
-		if(proSF_Ref[id] == NULL)	break;
-	/* references are used up, maximum allocation. */
-	if(id == REF_NUM)	return NULL;
+	if((uintptr_t)leftHpSaddr + chkSize > (uintptr_t)proSF_hpEaddr)
+	{
+		memRef_put(ref);
+		MEM_TRACE_ALLOC(NULL, reqSize);
+		MEM_STATS_FAIL();
+		return NULL;
+	}
 
 	/* memory space to be allocated. */
 	chk_alloc = (proSF_chk_hdr_t *)leftHpSaddr;
 	/* init this new chunk. */
 	chk_alloc->chk_size = chkSize;
-	proSF_Ref[id] = (void *)chk_alloc + sizeof(proSF_chk_hdr_t);
-	chk_alloc->chk_ref = (uint16_t *)&proSF_Ref[id];
+	MEM_REF(ref) = (uintptr_t)chk_alloc + sizeof(proSF_chk_hdr_t);
+	chk_alloc->chk_ref = ref;
+	MEM_STATS_ALLOC(chkSize);
+	MEM_QUOTA_ALLOC(chk_alloc->owner, chkSize);
 
 	/* update new heap starting address. */
 	leftHpSaddr += chkSize;
 
 	/* return chunk address. */
+	MEM_TRACE_ALLOC(chk_alloc->chk_ref, reqSize);
 	return chk_alloc->chk_ref;
 }
 
@@ -92,29 +127,269 @@ mem_alloc(uint8_t reqSize)
 void
 mem_free(uint16_t *chkMem)
 {
+	MEM_TRACE_FREE(chkMem);
+	
+	#if PROSF_DEFER_FREE
+	HAS_CRITICAL_SECTION;
+	proSF_chk_hdr_t *chk = (proSF_chk_hdr_t *)(MEM_REF(chkMem) - sizeof(proSF_chk_hdr_t));
+	
+	/* release the reference. */
+	memRef_put(chk->chk_ref);
+	MEM_STATS_FREE(chk->chk_size);
+	MEM_QUOTA_FREE(chk->owner, chk->chk_size);
+	
+	ENTER_CRITICAL_SECTION;
+	if((uintptr_t)chk + chk->chk_size == (uintptr_t)leftHpSaddr)
+	{
+		/* the last chunk, give it back at once. */
+		leftHpSaddr = chk;
+	}
+	else
+	{
+		/* mark it as dead, it will be removed by the compaction. */
+		chk->chk_ref = NULL;
+		if(proSF_deadQ == NULL || chk < proSF_deadQ)
+			proSF_deadQ = chk;
+	}
+	LEAVE_CRITICAL_SECTION;
+	#else
 	proSF_chk_hdr_t *m;
 	uint8_t *mvSaddr, *mvTo;
 	uint16_t i, sft_size;
 	
 	/* "*chkMem" will point to the data payload, 
 	   assign "mvTo" and "mvSaddr". */
-	mvTo = (uint8_t *)(*chkMem - sizeof(proSF_chk_hdr_t));
+	mvTo = (uint8_t *)(MEM_REF(chkMem) - sizeof(proSF_chk_hdr_t));
 	sft_size = ((proSF_chk_hdr_t *)mvTo)->chk_size;
 	mvSaddr = (uint8_t *)(mvTo + sft_size) ;
 	
 	/* release the reference. */
-	*(((proSF_chk_hdr_t *)mvTo)->chk_ref) = 0;
+	memRef_put(((proSF_chk_hdr_t *)mvTo)->chk_ref);
+	MEM_STATS_FREE(sft_size);
+	MEM_QUOTA_FREE(((proSF_chk_hdr_t *)mvTo)->owner, sft_size);
 	
 	/* update the references of the other chunks before memory coalescence. */
-	for(m = (proSF_chk_hdr_t *)mvSaddr; m != leftHpSaddr; m = (proSF_chk_hdr_t *)((uint16_t)m + m->chk_size))
-		*(m->chk_ref) -= ((proSF_chk_hdr_t *)mvTo)->chk_size;
+	for(m = (proSF_chk_hdr_t *)mvSaddr; m != leftHpSaddr; m = (proSF_chk_hdr_t *)((uintptr_t)m + m->chk_size))
+		MEM_REF(m->chk_ref) -= ((proSF_chk_hdr_t *)mvTo)->chk_size;
 	
 	/* memory coalescence. */
-	for(i = 0; i < ((uint16_t)leftHpSaddr - (uint16_t)mvSaddr); i++)
+	for(i = 0; i < ((uintptr_t)leftHpSaddr - (uintptr_t)mvSaddr); i++)
 		*(mvTo + i) = *(mvSaddr + i);
+	MEM_TRACE_MOVED(i);
+	if(i != 0)	MEM_STATS_COMPACT();
 	
 	/* update "leftHpSaddr". */
 	leftHpSaddr -= sft_size;
+	#endif
+}
+
+#if PROSF_DEFER_FREE
+/**
+ * @brief Remove all the dead chunks.
+ *	The free memory is in one piece at the heap end after that.
+ */
+void
+mem_compact(void)
+{
+	while(mem_compact_step(0xFFFF));
 }
 
+/**
+ * @brief One step of the compaction.
+ *	The lowest dead chunk is turned into a gap, which is moved up through the chunks above it, one chunk at a time: 
+ *	a live chunk just above it is moved down to its place word by word, and its reference is updated; 
+ *	a dead chunk just above it is merged into it. 
+ *	Once the gap reaches the heap end, it is given back to the free memory.
+ *
+ *	The gap is kept as the lowest dead chunk between the steps, 
+ *	thus the steps can be run from the idle loop and be mixed with the allocations and releases.
+ *
+ * \param budget	Maximum number of bytes moved by this step, at least one chunk is moved.
+ * \return		1 if dead chunks are left, 0 if all of them are removed.
+ */
+uint8_t
+mem_compact_step(uint16_t budget)
+{
+	HAS_CRITICAL_SECTION;
+	proSF_chk_hdr_t *gap, *m;
+	uint8_t *mvFrom, *mvTo;
+	uint16_t *ref;
+	uint16_t gapSize, chkSize, moved = 0, i;
+	
+	while(1)
+	{
+		ENTER_CRITICAL_SECTION;
+		gap = proSF_deadQ;
+		if(gap == NULL)
+		{
+			LEAVE_CRITICAL_SECTION;
+			if(moved != 0)	MEM_STATS_COMPACT();
+			return 0;
+		}
+		
+		gapSize = gap->chk_size;
+		m = (proSF_chk_hdr_t *)((uintptr_t)gap + gapSize);
+		
+		/* the gap reaches the heap end. */
+		if(m == leftHpSaddr)
+		{
+			leftHpSaddr = gap;
+			proSF_deadQ = NULL;
+			LEAVE_CRITICAL_SECTION;
+			if(moved != 0)	MEM_STATS_COMPACT();
+			return 0;
+		}
+		
+		/* merge the dead chunk into the gap. */
+		if(m->chk_ref == NULL)
+		{
+			gap->chk_size += m->chk_size;
+			LEAVE_CRITICAL_SECTION;
+			continue;
+		}
+		
+		chkSize = m->chk_size;
+		if(moved != 0 && moved + chkSize > budget)
+		{
+			LEAVE_CRITICAL_SECTION;
+			MEM_STATS_COMPACT();
+			return 1;
+		}
+		
+		/* keep the reference of the live chunk, its header is overwritten by the copy. */
+		ref = m->chk_ref;
+		
+		/* move the live chunk down, byte by byte, and update its reference. */
+		mvFrom = (uint8_t *)m;
+		mvTo = (uint8_t *)gap;
+		for(i = 0; i < chkSize; i++)
+			*mvTo++ = *mvFrom++;
+		MEM_TRACE_MOVED(chkSize);
+		MEM_REF(ref) -= gapSize;
+		
+		/* rebuild the gap above the moved chunk. */
+		gap = (proSF_chk_hdr_t *)((uintptr_t)gap + chkSize);
+		gap->chk_ref = NULL;
+		gap->chk_size = gapSize;
+		proSF_deadQ = gap;
+		LEAVE_CRITICAL_SECTION;
+		
+		moved += chkSize;
+	}
+}
+#endif
+
+#if MEM_STATS
+/**
+ * @brief Walk of the free memory for the heap statistics.
+ *	The adjacent dead chunks make one free chunk, the same as the free memory at the heap end.
+ *
+ * \param st	Add the free chunks into it by "memStats_chunk".
+ */
+void
+memStats_walk(mem_stats_t *st)
+{
+	uint16_t run = 0;
+	
+	#if PROSF_DEFER_FREE
+	proSF_chk_hdr_t *m;
+	/* the chunks may be moved by a release meanwhile, the walk is given up at once. */
+	for(m = (proSF_chk_hdr_t *)heapSaddr; (uintptr_t)m < (uintptr_t)leftHpSaddr; m = (proSF_chk_hdr_t *)((uintptr_t)m + m->chk_size))
+	{
+		if(MEM_STATS_CHANGED() || m->chk_size == 0)	return;
+		if(m->chk_ref == NULL)
+			run += m->chk_size;
+		else if(memStats_chunk(st, run))
+			return;
+		else
+			run = 0;
+	}
+	#endif
+	
+	memStats_chunk(st, run + ((uintptr_t)proSF_hpEaddr - (uintptr_t)leftHpSaddr));
+}
+#endif
+
+#if MEM_REF_GROW || MEM_ARENA
+/**
+ * @brief Carve a region from the heap end.
+ *		The free memory is always at the heap end, the region is taken from there.
+ *		The region is above the heap, it is never moved by a release or by the compaction.
+ *
+ * \param size	Size of the region.
+ * \param table	1 for a reference table, which cannot be carved under an open arena.
+ * \return		Starting address of the region, NULL if there is no enough memory left.
+ */
+static void*
+heap_carve(uint16_t size, uint8_t table)
+{
+	HAS_CRITICAL_SECTION;
+	void *region = NULL;
+	
+	#if PROSF_DEFER_FREE
+	if((uintptr_t)leftHpSaddr + size > (uintptr_t)proSF_hpEaddr)
+		mem_compact();
+	#endif
+	
+	ENTER_CRITICAL_SECTION;
+	if((uintptr_t)leftHpSaddr + size <= (uintptr_t)proSF_hpEaddr && !(table && MEM_ARENA_OPEN()))
+	{
+		proSF_hpEaddr -= size;
+		region = proSF_hpEaddr;
+	}
+	LEAVE_CRITICAL_SECTION;
+	return region;
+}
+#endif
+
+#if MEM_REF_GROW
+/**
+ * @brief Carve a reference table from the heap.
+ * \param size	Size of the table.
+ * \return		Starting address of the table, NULL if there is no enough memory left or an arena is open.
+ */
+void*
+memRef_carve(uint16_t size)
+{
+	return heap_carve(size, 1);
+}
+#endif
+
+#if MEM_ARENA
+/**
+ * @brief Carve the region of an arena from the heap end.
+ * \param size	Required size, it is kept as the size of the region.
+ * \return		Starting address of the region, NULL if there is no enough memory left.
+ */
+void*
+memArena_carve(uint16_t *size)
+{
+	return heap_carve(*size, 0);
+}
+
+/**
+ * @brief Give the region of an arena back to the heap.
+ *		Only the region at the heap end can be given back, the regions carved later are under it.
+ *
+ * \param region	Starting address of the region.
+ * \param size	Size of the region.
+ * \return		0 if given back, 1 if the region is not at the heap end.
+ */
+uint8_t
+memArena_uncarve(void *region, uint16_t size)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	if(region != proSF_hpEaddr)
+	{
+		LEAVE_CRITICAL_SECTION;
+		return 1;
+	}
+	proSF_hpEaddr += size;
+	LEAVE_CRITICAL_SECTION;
+	return 0;
+}
+#endif
+
 #endif
@@ -18,11 +18,17 @@
 #include "sys_config.h"
 #include "qlist_proc.h"
 #include "typedef.h"
+#include "mem_ref.h"
 
 #if	MEM_PROACTIVE_SF
 /* === Macros =============================================================== */
-/* reference number, maximum allocation. */
-#define REF_NUM		20
+/* opt-in: the released chunks are only marked as dead, and are removed by the compaction later.
+   By default, a release moves the chunks above it at once. It can be set per build in sys_config.h. */
+#ifndef PROSF_DEFER_FREE
+#define PROSF_DEFER_FREE	0
+#endif
+/* bytes moved by each step of the compaction in the idle loop. */
+#define COMPACT_STEP_BUDGET	32
 
 
 /* === Types ================================================================ */
@@ -30,15 +36,23 @@ typedef __ALIGNED2 struct proSF_chk_hdr
 {
 	uint16_t *chk_ref;			/* pointer linked to reference. */
 	uint16_t chk_size;			/* chunk size, including header "proSF_chk_hdr_t", used when chunk removing, etc. */
+	#if MEM_QUOTA
+	thrd_tcb_t *owner;			/* thread charged with this chunk. */
+	#endif
 } proSF_chk_hdr_t;
 
 /* === GLOBALS ============================================================= */
 extern void* leftHpSaddr;
-extern uint16_t* proSF_Ref[];
+extern void* proSF_hpEaddr;
+extern proSF_chk_hdr_t* proSF_deadQ;
 
 /* === Prototypes =========================================================== */
 extern uint16_t* mem_alloc(uint8_t reqSize);
 extern void mem_free(uint16_t *chkMem);
+#if PROSF_DEFER_FREE
+extern void mem_compact(void);
+extern uint8_t mem_compact_step(uint16_t budget);
+#endif
 
 
 #endif
@@ -0,0 +1,131 @@
+/**
+ * @file mem_quota.c
+ *
+ * @brief  Memory quota of the threads.
+ *			Each thread, the common thread included, has a quota and a counter of its live bytes in its TCB.
+ *			An allocation over the quota of the current thread is failed at once, before any search in the heap,
+ *			thus a thread using up its quota cannot make the allocations of the other threads fail.
+ *			A chunk too small to be split is taken whole, thus the quota is checked again on the size of the found chunk,
+ *			which is the size charged to the thread.
+ *
+ *			Each chunk keeps its owner in its header, the bytes are given back to the owner when the chunk is released,
+ *			whichever thread releases it. The bytes are counted in chunk sizes, the headers included.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include "typedef.h"
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+#include "mem_quota.h"
+
+#if MEM_QUOTA
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+
+
+/* === GLOBALS ============================================================= */
+
+
+/* === PROTOTYPES ========================================================== */
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Init the quota of a new thread.
+ * \param thrd	The thread.
+ */
+void
+mem_quota_init(thrd_tcb_t *thrd)
+{
+	thrd->mem_quota = MEM_QUOTA_DEFAULT;
+	thrd->mem_used = 0;
+}
+
+/**
+ * @brief Set the quota of a thread.
+ *	A quota lower than the live bytes fails the new allocations until enough of them are released.
+ *
+ * \param thrd	The thread.
+ * \param quota	Quota in bytes, 0xFFFF for no limit.
+ */
+void
+mem_quota_set(thrd_tcb_t *thrd, uint16_t quota)
+{
+	thrd->mem_quota = quota;
+}
+
+/**
+ * @brief Live bytes of a thread.
+ * \param thrd	The thread.
+ * \return		Bytes of the chunks allocated by this thread and not released yet.
+ */
+uint16_t
+mem_quota_used(thrd_tcb_t *thrd)
+{
+	HAS_CRITICAL_SECTION;
+	uint16_t used;
+
+	/* 16-bit counter, it may be updated by a release from an interrupt. */
+	ENTER_CRITICAL_SECTION;
+	used = thrd->mem_used;
+	LEAVE_CRITICAL_SECTION;
+	return used;
+}
+
+/**
+ * @brief Check the quota of the current thread before an allocation.
+ * \param size	Chunk size to be allocated.
+ * \return		1 if the quota would be exceeded, 0 otherwise.
+ */
+uint8_t
+memQuota_over(uint16_t size)
+{
+	HAS_CRITICAL_SECTION;
+	uint16_t used;
+
+	/* 16-bit counter, it may be updated by a release from an interrupt. */
+	ENTER_CRITICAL_SECTION;
+	used = curThrd->mem_used;
+	LEAVE_CRITICAL_SECTION;
+	return (used > curThrd->mem_quota || size > curThrd->mem_quota - used);
+}
+
+/**
+ * @brief Charge an allocated chunk to the current thread.
+ * \param owner	Owner field of the chunk header.
+ * \param size	Chunk size.
+ */
+void
+memQuota_alloc(thrd_tcb_t **owner, uint16_t size)
+{
+	HAS_CRITICAL_SECTION;
+
+	*owner = curThrd;
+	ENTER_CRITICAL_SECTION;
+	curThrd->mem_used += size;
+	LEAVE_CRITICAL_SECTION;
+}
+
+/**
+ * @brief Give the bytes of a released chunk back to its owner.
+ * \param owner	Owner of the chunk.
+ * \param size	Chunk size.
+ */
+void
+memQuota_free(thrd_tcb_t *owner, uint16_t size)
+{
+	HAS_CRITICAL_SECTION;
+
+	ENTER_CRITICAL_SECTION;
+	owner->mem_used -= size;
+	LEAVE_CRITICAL_SECTION;
+}
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file mem_quota.h
+ *
+ * @brief  header for mem_quota.c
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _MEM_QUOTA_H_
+#define _MEM_QUOTA_H_
+
+/* === Includes ============================================================= */
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+
+
+/* === Macros =============================================================== */
+/* quota of a new thread in bytes, it can be set per build in sys_config.h. 0xFFFF for no limit. */
+#ifndef MEM_QUOTA_DEFAULT
+#define MEM_QUOTA_DEFAULT	0xFFFF
+#endif
+
+/* hooks of the allocators, "sz" is the chunk size including the header,
+   "owner" is the owner field of the chunk header. */
+#if MEM_QUOTA
+#define MEM_QUOTA_OVER(sz)			memQuota_over(sz)
+#define MEM_QUOTA_ALLOC(owner, sz)	memQuota_alloc(&(owner), (sz))
+#define MEM_QUOTA_FREE(owner, sz)	memQuota_free((owner), (sz))
+#else
+#define MEM_QUOTA_OVER(sz)			0
+#define MEM_QUOTA_ALLOC(owner, sz)
+#define MEM_QUOTA_FREE(owner, sz)
+#endif
+
+
+/* === Types ================================================================ */
+
+
+/* === GLOBALS ============================================================= */
+
+
+/* === Prototypes =========================================================== */
+#if MEM_QUOTA
+extern void mem_quota_init(thrd_tcb_t *thrd);
+extern void mem_quota_set(thrd_tcb_t *thrd, uint16_t quota);
+extern uint16_t mem_quota_used(thrd_tcb_t *thrd);
+extern uint8_t memQuota_over(uint16_t size);
+extern void memQuota_alloc(thrd_tcb_t **owner, uint16_t size);
+extern void memQuota_free(thrd_tcb_t *owner, uint16_t size);
+#endif
+
+#endif
@@ -27,6 +27,10 @@
 
 #if MEM_REACTIVE_SF
 #include "mem_reactive_SF.h"
+#include "mem_trace.h"
+#include "mem_stats.h"
+#include "mem_arena.h"
+#include "mem_quota.h"
 /* === TYPES =============================================================== */
 
 
@@ -34,20 +38,23 @@
 
 
 /* === GLOBALS ============================================================= */
-/* references for the allocated chunks. Reference is 16-bit on AVR platform (uint16_t).
-   Reference will point to the data payload starting address (exclude the header) */
-uint16_t* reSF_Ref[REF_NUM];
-
 /* free memory list for reactive SF allocator. */
 reSF_chk_hdr_t* reSF_freeQ = NULL;	
 
+/* ending address of the heap, the reference tables carved from the heap are above it. */
+void* reSF_hpEaddr = NULL;
+
 #if KDEBUG_DEMO
 reSF_chk_hdr_t* reSF_allocQ = NULL;
 #endif
 
 
 /* === PROTOTYPES ========================================================== */
-
+static uint8_t fragment_move(uint16_t budget, uint8_t toEnd);
+static void chunk_insert(reSF_chk_hdr_t *chuk);
+#if MEM_REF_GROW || MEM_ARENA
+static void* heap_carve(uint16_t size, uint8_t table);
+#endif
 
 
 /* === IMPLEMENTATION ====================================================== */
@@ -65,42 +72,58 @@ uint16_t*
 mem_alloc(uint8_t objSz)
 {
 	reSF_chk_hdr_t *alloc = NULL;
-	uint8_t id;
-
-	/* allocate a reference for this chunk firstly. */
-	for(id = 0; id < REF_NUM; id++)
-		if(reSF_Ref[id] == 0)	break;
-	/* references are used up, maximum allocation. */
-	if(id == REF_NUM)	return NULL;
+	uint16_t *ref;
+	uint16_t ckSz;
 
 	/* Compute the required length. */
-	objSz = ALIGN(objSz+sizeof(reSF_chk_hdr_t), ALIGN_SIZE);
+	ckSz = ALIGN(objSz+sizeof(reSF_chk_hdr_t), ALIGN_SIZE);
+
+	/* allocate a reference for this chunk firstly. 
+	   References are used up, maximum allocation. 
+	   The allocation over the quota of the thread fails at once. */
+	if(MEM_QUOTA_OVER(ckSz) || (ref = memRef_get()) == NULL)
+	{
+		MEM_TRACE_ALLOC(NULL, objSz);
+		MEM_STATS_FAIL();
+		return NULL;
+	}
 
 	/* 1st time allocation from the free memory list.
-	   If failed, need to assemble all the memory fragments. */
-	if((alloc = mem_alloc_proc(objSz)) == NULL)
+	   If failed, need to assemble all the memory fragments. 
+	   Most of the fragments should have been assembled by the steps in the idle loop, 
+	   the full assembling here is the last resort. */
+	if((alloc = mem_alloc_proc(ckSz)) == NULL)
 	{
 		/* assemble all the fragments. */
 		fragment_assemble();
 	
-		/* 2nd time allocation, after fragments are assembled. 
-		   From the header of free memory list "reSF_freeQ" directly. */
-		if(reSF_freeQ->ckSize < objSz)	return NULL;
-		else
+		/* 2nd time allocation, after fragments are assembled. */
+		if((alloc = mem_alloc_proc(ckSz)) == NULL)
 		{
-			/* update reSF_freeQ. */
-			reSF_freeQ->ckSize -= objSz;
-			/* create new allocated chunk. */
-			alloc = (void *)reSF_freeQ + reSF_freeQ->ckSize - objSz;
-			alloc->ckSize = objSz;
-			alloc += sizeof(reSF_chk_hdr_t);
+			memRef_put(ref);
+			MEM_TRACE_ALLOC(NULL, objSz);
+			MEM_STATS_FAIL();
+			return NULL;
 		}
 	}
+	
+	/* the whole chunk is taken if it is too small to be split, and its size is charged. 
+	   Put it back if this size is over the quota. */
+	if(MEM_QUOTA_OVER(alloc->ckSize))
+	{
+		chunk_insert(alloc);
+		memRef_put(ref);
+		MEM_TRACE_ALLOC(NULL, objSz);
+		MEM_STATS_FAIL();
+		return NULL;
+	}
 		
 	/* allocation successfully, init reference and return.
 	   Reference will point to the starting address of data payload. */
-	reSF_Ref[id] = (void *)alloc + sizeof(reSF_chk_hdr_t);
-	alloc->ckRef = (uint16_t *)&reSF_Ref[id];
+	MEM_REF(ref) = (uintptr_t)alloc + sizeof(reSF_chk_hdr_t);
+	alloc->ckRef = ref;
+	MEM_STATS_ALLOC(alloc->ckSize);
+	MEM_QUOTA_ALLOC(alloc->owner, alloc->ckSize);
 	
 	/* Add this allocated object into the list */
 	#if KDEBUG_DEMO
@@ -121,6 +144,7 @@ mem_alloc(uint8_t objSz)
 	}
 	#endif	// KDEBUG_DEMO
 	
+	MEM_TRACE_ALLOC(alloc->ckRef, objSz);
 	return alloc->ckRef;
 }
 
@@ -133,10 +157,10 @@ mem_alloc(uint8_t objSz)
  * \return			Starting address of the allocated chunk.
  */
 void*
-mem_alloc_proc(uint8_t objSz)
+mem_alloc_proc(uint16_t objSz)
 {
 	reSF_chk_hdr_t *ck, *alloc = NULL;
-	uint8_t splitSz = 0;
+	uint16_t splitSz = 0;
 	
 	/* get the split size. If the free chunk size is larger then this, split it. */
 	#if !KDEBUG_DEMO
@@ -157,8 +181,7 @@ mem_alloc_proc(uint8_t objSz)
 		#if !KDEBUG_DEMO
 		if((ck->ckSize >= objSz) && (ck->ckSize <= splitSz))
 		{
-			/* initialization and return. The total size "splitSz" will be allocated. */
-			ck->ckSize = splitSz;	
+			/* too small to be split, the whole chunk is allocated and "ckSize" is kept. */
 			/* delete ck from the freed chunk queue. */
 			dlst_del((dlist **)(&reSF_freeQ), (dlist *)ck);
 			return ck;
@@ -177,7 +200,7 @@ mem_alloc_proc(uint8_t objSz)
 		if(ck->ckSize > splitSz)
 		{
 			/* split a piece from the bottom of this chunk. */
-			alloc = (reSF_chk_hdr_t *)((uint16_t)ck + ck->ckSize - objSz);
+			alloc = (reSF_chk_hdr_t *)((uintptr_t)ck + ck->ckSize - objSz);
 			alloc->ckSize = objSz;
 			/* new chunk update. */
 			ck->ckSize -= objSz;
@@ -195,47 +218,124 @@ mem_alloc_proc(uint8_t objSz)
 /**
  * @brief fragment assembling for the MIROS SF allocation
  *	Assemble all the fragments and update the references.
+ *	The free memory is in one chunk after that.
  */
 void
 fragment_assemble(void)
+{
+	while(fragment_assemble_step(0xFFFF));
+}
+
+
+/**
+ * @brief One step of the incremental fragment assembling.
+ *	The lowest free chunk is moved up through the allocated chunks above it, one chunk at a time: 
+ *	the allocated chunk just above it is moved down to its place, and its reference is updated. 
+ *	Once the free chunk reaches the next free one, they are merged.
+ *
+ *	No state is kept between the steps, thus the steps can be run from the idle loop 
+ *	or from a low-priority thread, and be mixed with the allocations.
+ *
+ * \param budget	Maximum number of bytes moved by this step, at least one chunk is moved.
+ * \return		1 if fragments are left, 0 if the free memory is in one chunk.
+ */
+uint8_t
+fragment_assemble_step(uint16_t budget)
+{
+	return fragment_move(budget, 0);
+}
+
+
+/**
+ * @brief Move the lowest free chunk up, through the allocated chunks above it.
+ *	See fragment_assemble_step().
+ *	If "toEnd" is set, the free chunk keeps being moved after the merging, until it reaches the heap end.
+ *
+ * \param budget	Maximum number of bytes moved by this step, at least one chunk is moved.
+ * \param toEnd	Move the free memory to the heap end.
+ * \return		1 if chunks are left to be moved, 0 if the free memory is in one chunk (at the heap end if "toEnd").
+ */
+static uint8_t
+fragment_move(uint16_t budget, uint8_t toEnd)
 {
 	HAS_CRITICAL_SECTION;
-	reSF_chk_hdr_t *frgmCk = reSF_freeQ->prev, *p;
+	reSF_chk_hdr_t *frgmCk, *ck, *old, hdr;
 	uint8_t *mvFrom, *mvTo;
-	uint8_t mvSize, i;
-	
-	/* if no fragments, return directly. */
-	if(frgmCk == reSF_freeQ)	return;
+	uint16_t *ref;
+	uint16_t ckSize, moved = 0, i;
 	
-	/* assign initialized "mvTo" address. */
-	mvTo = (uint8_t *)((uint16_t)frgmCk + frgmCk->ckSize - 1);
-	
-	/* assemble all fragments one by one. */
-	for(; frgmCk != reSF_freeQ; )
+	while(1)
 	{
-		/* assign mvStart. */
-		mvFrom = (uint8_t *)((uint16_t)frgmCk - 1);
+		ENTER_CRITICAL_SECTION;
+		/* if no fragments, return directly. */
+		frgmCk = reSF_freeQ;
+		if(frgmCk == NULL || (frgmCk->next == frgmCk && 
+			(!toEnd || (uintptr_t)frgmCk + frgmCk->ckSize == (uintptr_t)reSF_hpEaddr)))
+		{
+			LEAVE_CRITICAL_SECTION;
+			if(moved != 0)	MEM_STATS_COMPACT();
+			return 0;
+		}
+		
+		/* the chunk just above the lowest free chunk is allocated, 
+		   otherwise they would have been merged. */
+		ck = (reSF_chk_hdr_t *)((uintptr_t)frgmCk + frgmCk->ckSize);
+		ckSize = ck->ckSize;
+		if(moved != 0 && moved + ckSize > budget)
+		{
+			LEAVE_CRITICAL_SECTION;
+			MEM_STATS_COMPACT();
+			return 1;
+		}
 		
-		/* get the size to be moved. */
-		mvSize = (uint16_t)frgmCk - ((uint16_t)frgmCk->prev + frgmCk->prev->ckSize);
+		/* keep the free chunk header and the reference of the moved chunk, they are overwritten by the copy. */
+		hdr = *frgmCk;
+		ref = ck->ckRef;
 		
-		ENTER_CRITICAL_SECTION;
-		/* chunks will be moved. 
-		   Starting from chunk "frgmCk - mvSize", Ending to chunk "frgmCk".
-		   update the references of these chunks. 
-		   Update value is the size between "mvTo" and "frgmCk", but not the "mvSize". */
-		for(p = (reSF_chk_hdr_t *)((uint16_t)frgmCk - mvSize); p != frgmCk; p =(reSF_chk_hdr_t *)((uint16_t)p + p->ckSize))
-			*(p->ckRef) = *(p->ckRef) + ((uint16_t)mvTo + 1 - (uint16_t)frgmCk);
+		/* move the allocated chunk down, byte by byte, and update its reference. */
+		mvFrom = (uint8_t *)ck;
+		mvTo = (uint8_t *)frgmCk;
+		for(i = 0; i < ckSize; i++)
+			*mvTo++ = *mvFrom++;
+		MEM_TRACE_MOVED(ckSize);
+		MEM_REF(ref) -= hdr.ckSize;
 		
-		/* get next free chunk before data shifting. */
-		frgmCk = frgmCk->prev;
+		#if KDEBUG_DEMO
+		/* the allocated list links the chunk by its address. */
+		if(reSF_allocQ == ck)
+			reSF_allocQ = frgmCk;
+		else
+		{
+			reSF_chk_hdr_t *lst;
+			for(lst = reSF_allocQ; lst != NULL; lst = lst->next)
+			{
+				if(lst->next == ck)
+				{
+					lst->next = frgmCk;
+					break;
+				}
+			}
+		}
+		#endif	// KDEBUG_DEMO
 		
-		/* shift the chunks to clean up the memory fragments. 
-		   don't change the value of "to" since it will be used for the next step.
-		   value of "mvTo" has been updated after this shifting.  */		
-		for(i = 0; i < mvSize; i++)
-			*mvTo-- = *mvFrom--;
+		/* rebuild the free chunk above the moved one, it is still the lowest free chunk. */
+		old = frgmCk;
+		frgmCk = (reSF_chk_hdr_t *)((uintptr_t)frgmCk + ckSize);
+		*frgmCk = hdr;
+		if(hdr.next == old)
+			frgmCk->prev = frgmCk->next = frgmCk;
+		else
+		{
+			frgmCk->prev->next = frgmCk;
+			frgmCk->next->prev = frgmCk;
+		}
+		reSF_freeQ = frgmCk;
+		
+		/* merge with the next free chunk once they are adjacent. */
+		dlst_merge((dlist **)(&reSF_freeQ), (dlist *)frgmCk, (dlist *)frgmCk->next);
 		LEAVE_CRITICAL_SECTION;
+		
+		moved += ckSize;
 	}
 }
 
@@ -252,10 +352,14 @@ fragment_assemble(void)
 void
 mem_free(uint16_t *memRF)
 {
-	reSF_chk_hdr_t *chuk, *ck = reSF_freeQ;
+	reSF_chk_hdr_t *chuk;
 
+	MEM_TRACE_FREE(memRF);
+	
 	/* locates the chunk header position. */
-	chuk = (reSF_chk_hdr_t *)(*memRF - sizeof(reSF_chk_hdr_t));
+	chuk = (reSF_chk_hdr_t *)(MEM_REF(memRF) - sizeof(reSF_chk_hdr_t));
+	MEM_STATS_FREE(chuk->ckSize);
+	MEM_QUOTA_FREE(chuk->owner, chuk->ckSize);
 
 	/* remove this one from the allocated list "reSF_allocQ". */
 	#if KDEBUG_DEMO
@@ -270,41 +374,169 @@ mem_free(uint16_t *memRF)
 	}
 	#endif	// KDEBUG_DEMO
 	
+	chunk_insert(chuk);
+	
+	/* release the reference, whichever way the chunk has been put back. */
+	memRef_put(memRF);
+}
 
+
+/**
+ * @brief Put a free chunk into the free list reSF_freeQ, in the address order.
+ *		If two freed chunks are adjacent, coalesce them.
+ *
+ * \param chuk  The free chunk, its size is set.
+ */
+static void
+chunk_insert(reSF_chk_hdr_t *chuk)
+{
+	reSF_chk_hdr_t *ck = reSF_freeQ;
+	
 	/* If the queue is empty. */
 	if(reSF_freeQ == NULL)  {
 		reSF_freeQ = chuk;
 		reSF_freeQ->prev = reSF_freeQ->next = reSF_freeQ;
-		return;
 	}
-	
-	/* locate the insertion position. */
-	while(ck < chuk)	{
-		/* check next until find the available position. */
-		ck = ck->next;
-		/* if comes to the ends, then break, and will insert to the queue tail. */
-		if(ck == reSF_freeQ)	break;
+	else {
+		/* locate the insertion position. */
+		while(ck < chuk)	{
+			/* check next until find the available position. */
+			ck = ck->next;
+			/* if comes to the ends, then break, and will insert to the queue tail. */
+			if(ck == reSF_freeQ)	break;
+		}
+		
+		/* insert "chuk" in front of "ck". */
+		dlst_insert((dlist *)chuk, (dlist *)ck);
+		/* update the queue	head. */
+		if(chuk < reSF_freeQ)		reSF_freeQ =  chuk;
+		
+		/* debug information, to clear the data of the freed chunk. */
+		#if DEBUG_SUPPORT
+			memSFfree_debug(chuk);
+		#endif
+		
+		/* coalesce two free chunks if they are adjacent.
+		   firstly, upper-address merging, merge "chuk & chuk->next".
+		   later, lower-address merging, merge "chuk->prev & chuk". */
+		dlst_merge((dlist **)(&reSF_freeQ), (dlist *)chuk, (dlist *)chuk->next);
+		dlst_merge((dlist **)(&reSF_freeQ), (dlist *)chuk->prev, (dlist *)chuk);
 	}
+}
+
+
+#if MEM_REF_GROW || MEM_ARENA
+/**
+ * @brief Carve a region from the heap end.
+ *		The free memory is moved to the heap end firstly, and then the region is taken from there.
+ *		The region is above the heap, it is never moved by the fragment assembling.
+ *
+ * \param size	Size of the region.
+ * \param table	1 for a reference table, which cannot be carved under an open arena.
+ * \return		Starting address of the region, NULL if there is no enough memory left.
+ */
+static void*
+heap_carve(uint16_t size, uint8_t table)
+{
+	HAS_CRITICAL_SECTION;
+	reSF_chk_hdr_t *ck;
+	void *region = NULL;
 	
-	/* insert "chuk" in front of "ck". */
-	dlst_insert((dlist *)chuk, (dlist *)ck);
-	/* update the queue	head. */
-	if(chuk < reSF_freeQ)		reSF_freeQ =  chuk;
+	/* assemble all the fragments, and move the free memory to the heap end. */
+	while(fragment_move(0xFFFF, 1));
 	
-	/* debug information, to clear the data of the freed chunk. */
-	#if DEBUG_SUPPORT
-		memSFfree_debug(chuk);
-	#endif
+	/* a chunk released meanwhile is below the highest free chunk, which is at the heap end.
+	   Keep a free chunk large enough for its header. */
+	ENTER_CRITICAL_SECTION;
+	if(reSF_freeQ != NULL && !(table && MEM_ARENA_OPEN()))
+	{
+		ck = reSF_freeQ->prev;
+		if((uintptr_t)ck + ck->ckSize == (uintptr_t)reSF_hpEaddr && 
+			ck->ckSize >= size + sizeof(reSF_chk_hdr_t) + MIN_PAYLOAD_SIZE)
+		{
+			ck->ckSize -= size;
+			reSF_hpEaddr -= size;
+			region = reSF_hpEaddr;
+		}
+	}
+	LEAVE_CRITICAL_SECTION;
+	return region;
+}
+#endif
+
+#if MEM_REF_GROW
+/**
+ * @brief Carve a reference table from the heap.
+ * \param size	Size of the table.
+ * \return		Starting address of the table, NULL if there is no enough memory left or an arena is open.
+ */
+void*
+memRef_carve(uint16_t size)
+{
+	return heap_carve(size, 1);
+}
+#endif
+
+#if MEM_ARENA
+/**
+ * @brief Carve the region of an arena from the heap end.
+ * \param size	Required size, set to the size of the region. 
+ *				The region is large enough for a chunk header, as it is given back as a free chunk.
+ * \return		Starting address of the region, NULL if there is no enough memory left.
+ */
+void*
+memArena_carve(uint16_t *size)
+{
+	if(*size < sizeof(reSF_chk_hdr_t))	*size = sizeof(reSF_chk_hdr_t);
+	return heap_carve(*size, 0);
+}
+
+/**
+ * @brief Give the region of an arena back to the heap.
+ *		Only the region at the heap end can be given back, the regions carved later are under it.
+ *
+ * \param region	Starting address of the region.
+ * \param size	Size of the region.
+ * \return		0 if given back, 1 if the region is not at the heap end.
+ */
+uint8_t
+memArena_uncarve(void *region, uint16_t size)
+{
+	HAS_CRITICAL_SECTION;
+	reSF_chk_hdr_t *chuk = (reSF_chk_hdr_t *)region;
 	
-	/* coalesce two free chunks if they are adjacent.
-	   firstly, upper-address merging, merge "chuk & chuk->next".
-	   later, lower-address merging, merge "chuk->prev & chuk". */
-	dlst_merge((dlist **)(&reSF_freeQ), (dlist *)chuk, (dlist *)chuk->next);
-	dlst_merge((dlist **)(&reSF_freeQ), (dlist *)chuk->prev, (dlist *)chuk);
+	ENTER_CRITICAL_SECTION;
+	if(region != reSF_hpEaddr)
+	{
+		LEAVE_CRITICAL_SECTION;
+		return 1;
+	}
+	reSF_hpEaddr += size;
+	chuk->ckSize = size;
+	chunk_insert(chuk);
+	LEAVE_CRITICAL_SECTION;
+	return 0;
+}
+#endif
+
+
+#if MEM_STATS
+/**
+ * @brief Walk of the free memory for the heap statistics.
+ * \param st	Add the free chunks into it by "memStats_chunk".
+ */
+void
+memStats_walk(mem_stats_t *st)
+{
+	reSF_chk_hdr_t *ck = reSF_freeQ;
 	
-	/* release the reference. */
-	*memRF = 0;
+	if(ck == NULL)	return;
+	do {
+		if(memStats_chunk(st, ck->ckSize))	return;
+		ck = ck->next;
+	} while(ck != reSF_freeQ);
 }
+#endif
 
 
 #if DEBUG_SUPPORT
@@ -315,7 +547,7 @@ mem_free(uint16_t *memRF)
 void
 memSFfree_debug(reSF_chk_hdr_t *chuk)
 {
-	uint8_t i, *p = (uint8_t *)((uint16_t)chuk + sizeof(reSF_chk_hdr_t));
+	uint8_t i, *p = (uint8_t *)((uintptr_t)chuk + sizeof(reSF_chk_hdr_t));
 	for(i = 0; i < (chuk->ckSize - sizeof(reSF_chk_hdr_t)); i++)
 		*p++ = 0;
 };
@@ -17,15 +17,16 @@
 #include "kernel.h"
 #include "sys_config.h"
 #include "qlist_proc.h"
+#include "mem_ref.h"
 
 #if	MEM_REACTIVE_SF
 /* === Macros =============================================================== */
 /* the minimum size of a new split chunk should be larger than MIN_PAYLOAD_SIZE. */
 #define MIN_PAYLOAD_SIZE	8
-/* reference number, maximum allocation. */
-#define REF_NUM		20
 /* debug option for fragment assembling test. */
 #define FRAG_ASSMBL_DEBUG	0
+/* bytes moved by each step of the fragment assembling in the idle loop. */
+#define FRAG_STEP_BUDGET	32
 
 
 /* === Types ================================================================ */
@@ -36,6 +37,9 @@ typedef __ALIGNED2 struct reSF_chk_hdr
 	struct reSF_chk_hdr *next;	/* to next free chunk */
 	uint16_t ckSize;			/* size of whole chunk including the chuk_hdr */
 	uint16_t *ckRef;			/* the address of the reference to this chunk. */
+	#if MEM_QUOTA
+	thrd_tcb_t *owner;			/* thread charged with this chunk. */
+	#endif
 	#if KDEBUG_DEMO
 	uint8_t thrd_id;
 	#endif
@@ -44,12 +48,13 @@ typedef __ALIGNED2 struct reSF_chk_hdr
 
 /* === GLOBALS ============================================================= */
 extern reSF_chk_hdr_t* reSF_freeQ;
-extern uint16_t* reSF_Ref[];
+extern void* reSF_hpEaddr;
 extern reSF_chk_hdr_t* reSF_allocQ;
 
 extern uint16_t* mem_alloc(uint8_t objSz);
-extern void* mem_alloc_proc(uint8_t objSz);
+extern void* mem_alloc_proc(uint16_t objSz);
 extern void fragment_assemble(void);
+extern uint8_t fragment_assemble_step(uint16_t budget);
 extern void mem_free(uint16_t *memRF);
 extern void memSFfree_debug(reSF_chk_hdr_t *chuk);
 
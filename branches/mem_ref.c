@@ -0,0 +1,125 @@
+/**
+ * @file mem_ref.c
+ *
+ * @brief  References for the MIROS SF allocators.
+ *			The allocated chunks of the reactive and proactive SF allocators are moved when the fragments are assembled,
+ *			thus they are accessed through a reference, which is updated when the chunk is moved.
+ *			The free references are linked through the references themselves: 
+ *			a free reference holds the address of the next free one, 
+ *			so a reference is got and put back in constant time, without any extra memory.
+ *
+ *			If MEM_REF_GROW is set, a table of REF_GROW_NUM references is carved from the heap 
+ *			once the references are used up. The carved tables are never given back to the heap.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include "typedef.h"
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+
+#if MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+#include "mem_ref.h"
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+
+
+/* === GLOBALS ============================================================= */
+/* references for the allocated chunks.
+   Reference will point to the data payload starting address (exclude the header) */
+uintptr_t memRef_tbl[REF_NUM];
+
+/* list of the free references. */
+static uint16_t *memRef_freeQ = NULL;
+
+
+/* === PROTOTYPES ========================================================== */
+static void memRef_link(uintptr_t *tbl, uint16_t num);
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Add a table of references into the free list.
+ * \param tbl	Starting address of the table.
+ * \param num	Number of references in the table.
+ */
+static void
+memRef_link(uintptr_t *tbl, uint16_t num)
+{
+	/* link from the table end, so the references are got in the address order. */
+	while(num--)
+	{
+		tbl[num] = (uintptr_t)memRef_freeQ;
+		memRef_freeQ = (uint16_t *)&tbl[num];
+	}
+}
+
+/**
+ * @brief Initialization of the references, all of them are free.
+ */
+void
+memRef_init(void)
+{
+	memRef_freeQ = NULL;
+	memRef_link(memRef_tbl, REF_NUM);
+}
+
+/**
+ * @brief Get a free reference.
+ * \return	Address of the reference, it is cleared. NULL if the references are used up.
+ */
+uint16_t*
+memRef_get(void)
+{
+	HAS_CRITICAL_SECTION;
+	uint16_t *ref;
+	
+	#if MEM_REF_GROW
+	/* references are used up, carve a new table from the heap.
+	   The allocator may move its chunks to do this, so it is done out of the critical section. */
+	if(memRef_freeQ == NULL)
+	{
+		uintptr_t *tbl = memRef_carve(REF_GROW_NUM * sizeof(uintptr_t));
+		if(tbl != NULL)
+		{
+			ENTER_CRITICAL_SECTION;
+			memRef_link(tbl, REF_GROW_NUM);
+			LEAVE_CRITICAL_SECTION;
+		}
+	}
+	#endif
+	
+	ENTER_CRITICAL_SECTION;
+	ref = memRef_freeQ;
+	if(ref != NULL)
+	{
+		memRef_freeQ = (uint16_t *)MEM_REF(ref);
+		MEM_REF(ref) = 0;
+	}
+	LEAVE_CRITICAL_SECTION;
+	
+	return ref;
+}
+
+/**
+ * @brief Put a reference back into the free list.
+ * \param ref	The reference got by memRef_get().
+ */
+void
+memRef_put(uint16_t *ref)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	MEM_REF(ref) = (uintptr_t)memRef_freeQ;
+	memRef_freeQ = ref;
+	LEAVE_CRITICAL_SECTION;
+}
+
+#endif
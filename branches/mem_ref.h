@@ -0,0 +1,54 @@
+/**
+ * @file mem_ref.h
+ *
+ * @brief  header for mem_ref.c
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _MEM_REF_H_
+#define _MEM_REF_H_ 
+ 
+/* === Includes ============================================================= */
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+
+#if	MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+/* === Macros =============================================================== */
+/* reference number in the static table, it can be set per build in sys_config.h. */
+#ifndef REF_NUM
+#define REF_NUM			20
+#endif
+/* reference number of each table carved from the heap when the references are used up, 
+   used if MEM_REF_GROW is set. */
+#ifndef REF_GROW_NUM
+#define REF_GROW_NUM	8
+#endif
+
+/* A reference holds the address of the payload, it is 16-bit on AVR platform.
+   It is accessed as an address-sized integer, thus the allocators can be built for the host as well. */
+#define MEM_REF(ref)	(*(uintptr_t *)(ref))
+
+
+/* === Types ================================================================ */
+
+
+/* === GLOBALS ============================================================= */
+extern uintptr_t memRef_tbl[];
+
+
+/* === Prototypes =========================================================== */
+extern void memRef_init(void);
+extern uint16_t* memRef_get(void);
+extern void memRef_put(uint16_t *ref);
+#if MEM_REF_GROW
+/* carve a table from the heap, provided by the allocator. */
+extern void* memRef_carve(uint16_t size);
+#endif
+
+#endif
+#endif
@@ -0,0 +1,266 @@
+/**
+ * @file mem_replay_host.c
+ *
+ * @brief	Replay of an allocation trace in the host build.
+ *			Built with MEM_TRACE_HOST, MEM_STATS and one of the MIROS allocators (MEM_SFL, MEM_REACTIVE_SF, MEM_PROACTIVE_SF or MEM_TLSF),
+ *			it replays a trace dumped by "memTrace_dump" against this allocator: "mem_replay <trace file> [interval]".
+ *			The trace file is the dumps put one after another, framed as sent by "memTrace_dump".
+ *			The records lost on the node before a dump are reported, the releases of their objects are then unknown.
+ *			It is built by host/Makefile ("make -C host replay_all"), with the host headers of host/ in place of the node ones.
+ *			host/sys_config.h gives HEAP_EADDR, with about the heap size of the node (HEAP_SIZE).
+ *
+ *			It reports the latency percentiles of the allocations and of the releases, the peak heap usage,
+ *			the bytes moved by the fragment assembling or the compaction,
+ *			and, every "interval" records, the free memory and its fragmentation given by "mem_stats".
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#if MEM_TRACE_HOST
+/* the host "timer_t" is renamed, the MIROS one is used. */
+#define timer_t host_timer_t
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#undef timer_t
+#endif
+#include "typedef.h"
+#include "board.h"
+#include "kernel.h"
+#include "os_start.h"
+#include "mem_trace.h"
+#include "mem_stats.h"
+#include "mem_SFL.h"
+#include "mem_SFL_extHeap.h"
+#include "mem_reactive_SF.h"
+#include "mem_proactive_SF.h"
+#include "mem_TLSF.h"
+#include "mem_quota.h"
+
+#if MEM_TRACE_HOST && MEM_STATS
+
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+/* records between two lines of the fragmentation report. */
+#define REPLAY_INTERVAL		100
+
+
+/* === GLOBALS ============================================================= */
+/* handles of the trace to the handles of the replay. */
+static void *replayMap[0x10000];
+/* latencies of the operations. */
+static uint32_t *latAlloc, *latFree;
+static uint32_t nAlloc = 0, nFree = 0;
+/* allocations failed on the node, releases of unknown objects. */
+static uint32_t nodeFails = 0, unknown = 0;
+
+
+/* === PROTOTYPES ========================================================== */
+static uint32_t replay_clock(void);
+static void* replay_alloc(uint16_t size);
+static int replay_cmp(const void *a, const void *b);
+static void replay_latency(const char *name, uint32_t *lat, uint32_t n);
+static void replay_record(uint8_t *rec);
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Clock of the replay in ns.
+ */
+static uint32_t
+replay_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000000ul + ts.tv_nsec);
+}
+
+/**
+ * @brief Allocation by the allocator under test.
+ * \param size	Required size.
+ * \return		Handle of the allocated object, NULL if failed.
+ */
+static void*
+replay_alloc(uint16_t size)
+{
+	#if MEM_SFL
+	return mem_alloc_sz(size);
+	#elif MEM_REACTIVE_SF || MEM_PROACTIVE_SF
+	return (size > 0xFF) ? NULL : mem_alloc((uint8_t)size);
+	#else
+	return mem_alloc(size);
+	#endif
+}
+
+static int
+replay_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Print the latency percentiles of an operation.
+ */
+static void
+replay_latency(const char *name, uint32_t *lat, uint32_t n)
+{
+	if(n == 0)
+	{
+		printf("%-6s %8u\n", name, 0);
+		return;
+	}
+
+	qsort(lat, n, sizeof(uint32_t), replay_cmp);
+	printf("%-6s %8u %8u %8u %8u %8u\n", name, n,
+		lat[n / 2], lat[(n * 9) / 10], lat[(n * 99) / 100], lat[n - 1]);
+}
+
+/**
+ * @brief Replay one record against the allocator under test.
+ * \param rec	The record, MEM_TRACE_REC_SIZE bytes.
+ */
+static void
+replay_record(uint8_t *rec)
+{
+	uint16_t size, handle;
+	uint32_t t;
+	void *h;
+
+	size = (rec[1] << 8) | rec[2];
+	handle = (rec[3] << 8) | rec[4];
+
+	switch(rec[0])
+	{
+		case MEM_OP_ALLOC:
+		case MEM_OP_FAIL:
+			t = replay_clock();
+			h = replay_alloc(size);
+			latAlloc[nAlloc++] = replay_clock() - t;
+			if(rec[0] == MEM_OP_FAIL)
+			{
+				/* failed on the node, the object is not used. */
+				nodeFails++;
+				if(h != NULL)	mem_free(h);
+			}
+			else
+				replayMap[handle] = h;
+			break;
+
+		case MEM_OP_FREE:
+			/* allocated before the trace or in the lost records, or failed in the replay. */
+			if((h = replayMap[handle]) == NULL)
+			{
+				unknown++;
+				break;
+			}
+			t = replay_clock();
+			mem_free(h);
+			latFree[nFree++] = replay_clock() - t;
+			replayMap[handle] = NULL;
+			break;
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	FILE *f;
+	uint8_t *trace, *rec;
+	uint32_t len, pos, end, n = 0, i, interval;
+	uint32_t heapSize, frames = 0, lost = 0;
+	uint16_t cnt, frameLost;
+	mem_stats_t st;
+
+	if(argc < 2)
+	{
+		printf("usage: mem_replay <trace file> [interval]\n");
+		return 1;
+	}
+	interval = (argc > 2) ? (uint32_t)atoi(argv[2]) : REPLAY_INTERVAL;
+	if(interval == 0)	interval = REPLAY_INTERVAL;
+
+	/* load the trace. */
+	if((f = fopen(argv[1], "rb")) == NULL)
+	{
+		printf("cannot open %s\n", argv[1]);
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	trace = malloc(len + 1);
+	len = fread(trace, 1, len, f);
+	fclose(f);
+	latAlloc = malloc((len / MEM_TRACE_REC_SIZE + 1) * sizeof(uint32_t));
+	latFree = malloc((len / MEM_TRACE_REC_SIZE + 1) * sizeof(uint32_t));
+
+	/* the same initialization as "software_init", for the allocator. */
+	curThrd = &common_thread;
+	#if MEM_QUOTA
+	mem_quota_init(curThrd);
+	#endif
+	heapSaddr = &_sys_data_end;
+	mem_init();
+	mem_stats(&st);
+	heapSize = st.freeSz;
+
+	printf("record   time     used     free  largest  frags  frag(%%)\n");
+	for(pos = 0; pos < len; pos = end + 1, frames++)
+	{
+		/* check the frame of the dump. */
+		if(len - pos < MEM_TRACE_HDR_SIZE + 1 || trace[pos] != MEM_TRACE_HEAD)
+		{
+			printf("bad frame head at byte %u\n", pos);
+			return 1;
+		}
+		cnt = (trace[pos + 2] << 8) | trace[pos + 3];
+		frameLost = (trace[pos + 4] << 8) | trace[pos + 5];
+		end = pos + MEM_TRACE_HDR_SIZE + (uint32_t)cnt * MEM_TRACE_REC_SIZE;
+		if(end >= len || trace[end] != MEM_TRACE_TAIL)
+		{
+			printf("bad frame tail at byte %u\n", end);
+			return 1;
+		}
+		if(frameLost != 0)
+		{
+			printf("dump %u: %u records lost before record %u\n", frames, frameLost, n);
+			lost += frameLost;
+		}
+
+		for(i = 0, rec = trace + pos + MEM_TRACE_HDR_SIZE; i < cnt; i++, n++, rec += MEM_TRACE_REC_SIZE)
+		{
+			replay_record(rec);
+
+			if(n % interval == 0 || (end + 1 == len && i == cnt - 1))
+			{
+				mem_stats(&st);
+				/* the free blocks of the SFL partitions are not chunks, they are out of the fragmentation. */
+				printf("%6u %6u %8u %8u %8u %6u %8u\n", n, (rec[5] << 8) | rec[6], st.used, st.freeSz, st.largest, st.frags,
+					(st.freeSz == st.ptFree) ? 0 : (uint32_t)(100 - (uint32_t)st.largest * 100 / (st.freeSz - st.ptFree)));
+			}
+		}
+	}
+
+	printf("\nlatency(ns)   num      p50      p90      p99      max\n");
+	replay_latency("alloc", latAlloc, nAlloc);
+	replay_latency("free", latFree, nFree);
+	mem_stats(&st);
+	printf("\ndumps %u, records %u, lost records %u\n", frames, n, lost);
+	printf("failed allocations %u (%u on the node), unknown releases %u\n", st.fails, nodeFails, unknown);
+	printf("peak heap usage %u of %u bytes\n", st.peak, heapSize);
+	printf("compaction steps %u, bytes moved %u\n", st.compactions, memTrace_moved);
+
+	free(trace);
+	free(latAlloc);
+	free(latFree);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,196 @@
+/**
+ * @file mem_stats.c
+ *
+ * @brief  Heap statistics of the MIROS allocators.
+ *			The used bytes, the failed allocations and the compactions are counted by the allocators as they go.
+ *			The free bytes, the largest free chunk and the number of free chunks are got by a walk 
+ *			of the free memory, done by the allocator in "memStats_walk". 
+ *			As the free chunks are few, "mem_stats" can be called periodically 
+ *			to watch the heap degradation of a long-running node.
+ *
+ *			The walk is done with the interrupts enabled. Each change of the free memory is counted in "memStats_gen",
+ *			a walk meeting a change is given up and done again, and the last try is done with the interrupts disabled.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include "typedef.h"
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+#include "kdebug.h"
+#include "mem_stats.h"
+
+#if MEM_STATS
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+/* walks given up because of a change, before the walk with the interrupts disabled. */
+#define MEM_STATS_TRIES		3
+
+
+/* === GLOBALS ============================================================= */
+/* counters kept by the allocators. */
+uint16_t memStats_used = 0;
+uint16_t memStats_fails = 0;
+uint16_t memStats_compactions = 0;
+static uint16_t memStats_peak = 0;
+/* changes of the free memory, and the value at the start of the current walk. */
+volatile uint8_t memStats_gen = 0;
+uint8_t memStats_walkGen = 0;
+
+
+/* === PROTOTYPES ========================================================== */
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Count an allocated chunk.
+ * \param size	Chunk size, including the header.
+ */
+void
+memStats_alloc(uint16_t size)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	memStats_used += size;
+	if(memStats_used > memStats_peak)
+		memStats_peak = memStats_used;
+	memStats_gen++;
+	LEAVE_CRITICAL_SECTION;
+}
+
+/**
+ * @brief Count a released chunk.
+ * \param size	Chunk size, including the header.
+ */
+void
+memStats_free(uint16_t size)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	memStats_used -= size;
+	memStats_gen++;
+	LEAVE_CRITICAL_SECTION;
+}
+
+/**
+ * @brief Count a failed allocation or a compaction step.
+ * \param cnt	The counter.
+ */
+void
+memStats_event(uint16_t *cnt)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	(*cnt)++;
+	memStats_gen++;
+	LEAVE_CRITICAL_SECTION;
+}
+
+/**
+ * @brief Count a free chunk, called by "memStats_walk".
+ * \param st	The statistics.
+ * \param size	Size of the free chunk.
+ * \return		1 if the free memory has been changed, and the walk must be given up, 0 otherwise.
+ */
+uint8_t
+memStats_chunk(mem_stats_t *st, uint16_t size)
+{
+	if(MEM_STATS_CHANGED())	return 1;
+	if(size == 0)	return 0;
+	st->freeSz += size;
+	st->frags++;
+	if(size > st->largest)
+		st->largest = size;
+	return 0;
+}
+
+/**
+ * @brief Get the heap statistics.
+ * \param st	Return the statistics.
+ */
+void
+mem_stats(mem_stats_t *st)
+{
+	HAS_CRITICAL_SECTION;
+	uint8_t tries;
+	
+	for(tries = 0; ; tries++)
+	{
+		st->freeSz = st->ptFree = st->largest = st->frags = 0;
+		
+		ENTER_CRITICAL_SECTION;
+		memStats_walkGen = memStats_gen;
+		/* the memory keeps being changed, the last try is done with the interrupts disabled. */
+		if(tries == MEM_STATS_TRIES)
+		{
+			memStats_walk(st);
+			break;
+		}
+		LEAVE_CRITICAL_SECTION;
+		
+		memStats_walk(st);
+		
+		ENTER_CRITICAL_SECTION;
+		if(!MEM_STATS_CHANGED())	break;
+		LEAVE_CRITICAL_SECTION;
+	}
+	
+	/* the counters match the walk, the interrupts are still disabled. */
+	st->used = memStats_used;
+	st->peak = memStats_peak;
+	st->fails = memStats_fails;
+	st->compactions = memStats_compactions;
+	LEAVE_CRITICAL_SECTION;
+}
+
+/**
+ * @brief Clear the peak and the counted events, the used bytes are kept.
+ */
+void
+mem_stats_reset(void)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	memStats_peak = memStats_used;
+	memStats_fails = 0;
+	memStats_compactions = 0;
+	LEAVE_CRITICAL_SECTION;
+}
+
+/**
+ * @brief Send the heap statistics to the debug board.
+ */
+void
+mem_stats_dump(void)
+{
+	mem_stats_t st;
+	
+	mem_stats(&st);
+	
+	/* send the header firstly */
+	kDebug8bit(0xAD);
+	kDebug8bit(memStats_debugID);
+	/* send the body code */
+	kDebug16bit(st.freeSz);
+	kDebug16bit(st.largest);
+	kDebug16bit(st.frags);
+	kDebug16bit(st.used);
+	kDebug16bit(st.peak);
+	kDebug16bit(st.fails);
+	kDebug16bit(st.compactions);
+	kDebug16bit(st.ptFree);
+	/* send the tail */
+	kDebug8bit(0xFF);
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file mem_stats.h
+ *
+ * @brief  header for mem_stats.c
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _MEM_STATS_H_
+#define _MEM_STATS_H_ 
+ 
+/* === Includes ============================================================= */
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+
+
+/* === Macros =============================================================== */
+/* hooks of the allocators, "sz" is the chunk size including the header.
+   The releases can be done from an ISR, thus the counters are updated with the interrupts disabled. */
+#if MEM_STATS
+#define MEM_STATS_ALLOC(sz)		memStats_alloc(sz)
+#define MEM_STATS_FREE(sz)		memStats_free(sz)
+#define MEM_STATS_FAIL()		memStats_event(&memStats_fails)
+#define MEM_STATS_COMPACT()		memStats_event(&memStats_compactions)
+/* the free memory has been changed since the walk was started, the walk must be given up. */
+#define MEM_STATS_CHANGED()		(memStats_gen != memStats_walkGen)
+#else
+#define MEM_STATS_ALLOC(sz)		do { } while(0)
+#define MEM_STATS_FREE(sz)		do { } while(0)
+#define MEM_STATS_FAIL()		do { } while(0)
+#define MEM_STATS_COMPACT()		do { } while(0)
+#endif
+
+
+/* === Types ================================================================ */
+#if MEM_STATS
+/* heap statistics. For the SFL allocator, the blocks of the partitions are counted with the extended heap,
+   a free block is in "freeSz" and "ptFree", but it is not a free chunk of "largest" and "frags". */
+typedef struct mem_stats
+{
+	uint16_t freeSz;		/* free bytes. */
+	uint16_t ptFree;		/* free bytes in the SFL partitions, included in "freeSz". */
+	uint16_t largest;		/* largest contiguous free bytes. */
+	uint16_t frags;			/* number of free chunks. */
+	uint16_t used;			/* bytes of the allocated chunks, headers included. */
+	uint16_t peak;			/* peak of "used" since the last reset. */
+	uint16_t fails;			/* failed allocations. */
+	uint16_t compactions;	/* fragment assembling or compaction steps which moved chunks. */
+} mem_stats_t;
+#endif
+
+
+/* === GLOBALS ============================================================= */
+#if MEM_STATS
+extern uint16_t memStats_used;
+extern uint16_t memStats_fails;
+extern uint16_t memStats_compactions;
+extern volatile uint8_t memStats_gen;
+extern uint8_t memStats_walkGen;
+#endif
+
+
+/* === Prototypes =========================================================== */
+#if MEM_STATS
+extern void mem_stats(mem_stats_t *st);
+extern void mem_stats_reset(void);
+extern void mem_stats_dump(void);
+extern void memStats_alloc(uint16_t size);
+extern void memStats_free(uint16_t size);
+extern void memStats_event(uint16_t *cnt);
+/* walk of the free memory, provided by the allocator. */
+extern void memStats_walk(mem_stats_t *st);
+extern uint8_t memStats_chunk(mem_stats_t *st, uint16_t size);
+#endif
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * @file mem_trace.c
+ *
+ * @brief  Trace of the memory allocations.
+ *			With MEM_TRACE, every allocation and release of the MIROS allocators is recorded in a ring 
+ *			of MEM_TRACE_NUM records, together with its size, its handle and the system time. 
+ *			The records are sent to the debug board by "memTrace_dump", 
+ *			and the trace can then be replayed on the host against each allocator (mem_replay_host.c).
+ *
+ *			The handle is the address returned by "mem_alloc": the reference for the SF allocators, 
+ *			the payload address for the others. It is only used to match a release to its allocation.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include "typedef.h"
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+#include "kdebug.h"
+#include "timer_ACV.h"
+#include "mem_trace.h"
+
+#if MEM_TRACE || MEM_TRACE_HOST
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+
+
+/* === GLOBALS ============================================================= */
+/* bytes moved by the fragment assembling or the compaction. */
+uint32_t memTrace_moved = 0;
+
+#if MEM_TRACE
+/* ring of the records. */
+static mem_trace_rec_t memTrace_ring[MEM_TRACE_NUM];
+/* index of the oldest record, and number of records. */
+static uint8_t memTrace_head = 0;
+static uint8_t memTrace_len = 0;
+/* records overwritten before being dumped. */
+static uint16_t memTrace_lost = 0;
+#endif
+
+
+/* === PROTOTYPES ========================================================== */
+
+
+/* === IMPLEMENTATION ====================================================== */
+#if MEM_TRACE
+/**
+ * @brief Record an allocation or a release.
+ * \param op		MEM_OP_ALLOC, MEM_OP_FREE or MEM_OP_FAIL.
+ * \param handle	Address returned by "mem_alloc".
+ * \param size		Required size, 0 for a release.
+ */
+void
+memTrace_record(uint8_t op, void *handle, uint16_t size)
+{
+	HAS_CRITICAL_SECTION;
+	mem_trace_rec_t *rec;
+	
+	ENTER_CRITICAL_SECTION;
+	if(memTrace_len == MEM_TRACE_NUM)
+	{
+		/* overwrite the oldest one. */
+		memTrace_head = (memTrace_head + 1) % MEM_TRACE_NUM;
+		memTrace_len--;
+		memTrace_lost++;
+	}
+	rec = &memTrace_ring[(memTrace_head + memTrace_len) % MEM_TRACE_NUM];
+	memTrace_len++;
+	
+	rec->time = (uint16_t)GetSysTime();
+	rec->handle = (uint16_t)(uintptr_t)handle;
+	rec->size = size;
+	rec->op = op;
+	LEAVE_CRITICAL_SECTION;
+}
+
+/**
+ * @brief Send the records to the debug board, from the oldest one, and clear them.
+ *
+ *	Format: MEM_TRACE_HEAD, memTrace_debugID, number of records (16-bit), lost records (16-bit), 
+ *	the records (MEM_TRACE_REC_SIZE bytes each), MEM_TRACE_TAIL.
+ *	The dumps put one after another, as received by the debug board, make the trace file of the host replay.
+ *	The lost records were overwritten before the first record of the dump, the replay reports them.
+ *	The records overwritten during the dump are counted in the next dump.
+ */
+void
+memTrace_dump(void)
+{
+	HAS_CRITICAL_SECTION;
+	mem_trace_rec_t rec;
+	uint8_t len;
+	uint16_t lost;
+	
+	/* the lost records are taken with the records, a record overwritten from now on is counted again. */
+	ENTER_CRITICAL_SECTION;
+	len = memTrace_len;
+	lost = memTrace_lost;
+	memTrace_lost = 0;
+	LEAVE_CRITICAL_SECTION;
+	
+	/* send the header firstly */
+	kDebug8bit(MEM_TRACE_HEAD);
+	kDebug8bit(memTrace_debugID);
+	kDebug16bit(len);
+	kDebug16bit(lost);
+	
+	/* send the body code, the records made meanwhile are kept for the next dump. */
+	while(len--)
+	{
+		ENTER_CRITICAL_SECTION;
+		rec = memTrace_ring[memTrace_head];
+		memTrace_head = (memTrace_head + 1) % MEM_TRACE_NUM;
+		memTrace_len--;
+		LEAVE_CRITICAL_SECTION;
+		
+		kDebug8bit(rec.op);
+		kDebug16bit(rec.size);
+		kDebug16bit(rec.handle);
+		kDebug16bit(rec.time);
+	}
+	
+	/* send the tail */
+	kDebug8bit(MEM_TRACE_TAIL);
+}
+
+/**
+ * @brief Clear the records and the counters.
+ */
+void
+memTrace_reset(void)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	memTrace_head = memTrace_len = 0;
+	memTrace_lost = 0;
+	memTrace_moved = 0;
+	LEAVE_CRITICAL_SECTION;
+}
+#endif
+
+#endif
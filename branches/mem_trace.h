@@ -0,0 +1,79 @@
+/**
+ * @file mem_trace.h
+ *
+ * @brief  header for mem_trace.c
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _MEM_TRACE_H_
+#define _MEM_TRACE_H_ 
+ 
+/* === Includes ============================================================= */
+#include "board.h"
+#include "kernel.h"
+#include "sys_config.h"
+
+
+/* === Macros =============================================================== */
+/* number of records kept on the node, the oldest ones are overwritten. */
+#define MEM_TRACE_NUM		64
+/* frame of a dump: head tag, debug ID, number of records and lost records, the records, and the tail tag.
+   16-bit values are sent in big endian. */
+#define MEM_TRACE_HEAD		0xAD
+#define MEM_TRACE_TAIL		0xFF
+#define MEM_TRACE_HDR_SIZE	6
+/* size of a record in the dumped trace: op, size, handle and time. */
+#define MEM_TRACE_REC_SIZE	7
+
+/* operations of the records. */
+#define MEM_OP_ALLOC		0x01
+#define MEM_OP_FREE			0x02
+#define MEM_OP_FAIL			0x03
+
+/* hooks of the allocators. */
+#if MEM_TRACE
+#define MEM_TRACE_ALLOC(h, sz)	memTrace_record(((h) != NULL) ? MEM_OP_ALLOC : MEM_OP_FAIL, (h), (sz))
+#define MEM_TRACE_FREE(h)		memTrace_record(MEM_OP_FREE, (h), 0)
+#else
+#define MEM_TRACE_ALLOC(h, sz)
+#define MEM_TRACE_FREE(h)
+#endif
+/* bytes moved by the fragment assembling or the compaction, also counted by the host replay. */
+#if MEM_TRACE || MEM_TRACE_HOST
+#define MEM_TRACE_MOVED(n)		(memTrace_moved += (n))
+#else
+#define MEM_TRACE_MOVED(n)
+#endif
+
+
+/* === Types ================================================================ */
+#if MEM_TRACE
+/* an allocation or a release. */
+typedef __ALIGNED2 struct mem_trace_rec
+{
+	uint16_t time;		/* system time in ms, wraps around. */
+	uint16_t handle;	/* address returned by "mem_alloc", 0 if failed. */
+	uint16_t size;		/* required size, 0 for a release. */
+	uint8_t op;			/* MEM_OP_ALLOC, MEM_OP_FREE or MEM_OP_FAIL. */
+} mem_trace_rec_t;
+#endif
+
+
+/* === GLOBALS ============================================================= */
+#if MEM_TRACE || MEM_TRACE_HOST
+extern uint32_t memTrace_moved;
+#endif
+
+
+/* === Prototypes =========================================================== */
+#if MEM_TRACE
+extern void memTrace_record(uint8_t op, void *handle, uint16_t size);
+extern void memTrace_dump(void);
+extern void memTrace_reset(void);
+#endif
+
+#endif
@@ -0,0 +1,237 @@
+/**
+ * @file msgq.c
+ *
+ * @brief  message queue (mailbox) to pass the data among the threads.
+ *
+ *			Each message is copied into a fixed-size slot of the queue buffer, and copied out by the receiver.
+ *			If a receiver is already waiting, the message is handed over to its buffer directly, 
+ *			without being copied into the slots. In the same way, a blocked sender's message 
+ *			is moved into the slot freed by the receiver.
+ *
+ * @author	  Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include <string.h>
+#include "evt_driven_sched.h"
+#include "msgq.h"
+#include "semaphore.h"
+#include "kernel.h"
+#include "multithreading_sched.h"
+#include "kdebug.h"
+
+#if	RT_SUPPORT
+
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+/* address of the i-th slot. */
+#define MSGQ_SLOT(q, i)		((q)->buf + (uint16_t)(i) * (q)->slotSize)
+
+
+/* === GLOBALS ============================================================= */
+
+
+/* === PROTOTYPES ========================================================== */
+static uint8_t msgq_put(msgq_t *q, const void *msg, uint8_t *wakeup);
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Function to initialize the message queue.
+ * \param q			Pointer to a message queue structure.
+ * \param buf		Slot buffer, at least "slotSize*slotNum" bytes.
+ * \param slotSize	Size of each message.
+ * \param slotNum	Number of slots.
+ */
+void 
+msgq_init(msgq_t *q, void *buf, uint8_t slotSize, uint8_t slotNum)
+{
+	q->buf = buf;
+	q->slotSize = slotSize;
+	q->slotNum = slotNum;
+	q->head = q->count = 0;
+	q->sendQ_hdr = q->recvQ_hdr = NULL;
+}
+
+/** 
+ * @brief Send a message, wait if the queue is full.
+ * \param q			The message queue.
+ * \param msg		Message to be sent, "slotSize" bytes.
+ * \param timeout	Maximum waiting time in ms, 0 to not wait, or WAIT_FOREVER.
+ * \return			0 if the message is queued, QUEUE_FULL or TIMEOUT otherwise.
+ */
+uint8_t
+msgq_send(msgq_t *q, const void *msg, uint16_t timeout)
+{
+	HAS_CRITICAL_SECTION;
+	uint8_t rslt, wakeup = 0;
+	
+	ENTER_CRITICAL_SECTION;
+	rslt = msgq_put(q, msg, &wakeup);
+	
+	/* queue is full, wait in the queue if allowed. 
+	   The receiver will move the message from "wait_data" into the slots. */
+	if((rslt == QUEUE_FULL) && (timeout != 0))
+	{
+		curThrd->wait_data = (void *)msg;
+		thrd_wait_prep(&q->sendQ_hdr, timeout);
+		LEAVE_CRITICAL_SECTION;
+		
+		/* call task dispatcher */
+		thread_dispatcher();
+		return curThrd->wait_rslt;
+	}
+	LEAVE_CRITICAL_SECTION;
+	
+	/* a receiver has been woken up. */
+	if(wakeup)
+		thread_dispatcher();
+	
+	return rslt;
+}
+
+/** 
+ * @brief Post a message without waiting.
+ * \param q			The message queue.
+ * \param msg		Message to be sent, "slotSize" bytes.
+ * \param action	Whether force the thread switch if a receiver is woken up.
+ * \return			0 if the message is queued, QUEUE_FULL otherwise.
+ *
+ * It can be called from the ISR.
+ */
+uint8_t
+msgq_post(msgq_t *q, const void *msg, uint8_t action)
+{
+	HAS_CRITICAL_SECTION;
+	uint8_t rslt, wakeup = 0;
+	
+	ENTER_CRITICAL_SECTION;
+	rslt = msgq_put(q, msg, &wakeup);
+	LEAVE_CRITICAL_SECTION;
+	
+	/* force the thread dispatcher now if it is required. */
+	if(wakeup && (action == DISPATCHER))
+		thread_dispatcher();
+	
+	return rslt;
+}
+
+/** 
+ * @brief Receive a message, wait if the queue is empty.
+ * \param q			The message queue.
+ * \param msg		Buffer for the message, "slotSize" bytes.
+ * \param timeout	Maximum waiting time in ms, 0 to not wait, or WAIT_FOREVER.
+ * \return			0 if a message is received, QUEUE_EMPTY or TIMEOUT otherwise.
+ */
+uint8_t
+msgq_recv(msgq_t *q, void *msg, uint16_t timeout)
+{
+	HAS_CRITICAL_SECTION;
+	thrd_tcb_t *thrd;
+	uint16_t tail;		/* "head + count" can exceed 255 with more than 128 slots. */
+	
+	ENTER_CRITICAL_SECTION;
+	/* get the oldest message from the slots. */
+	if(q->count > 0)
+	{
+		memcpy(msg, MSGQ_SLOT(q, q->head), q->slotSize);
+		if(++q->head == q->slotNum)
+			q->head = 0;
+		q->count--;
+		
+		/* move the message of the first blocked sender into the freed slot. */
+		thrd = q->sendQ_hdr;
+		if(thrd != NULL)
+		{
+			tail = q->head + q->count;
+			if(tail >= q->slotNum)
+				tail -= q->slotNum;
+			memcpy(MSGQ_SLOT(q, tail), thrd->wait_data, q->slotSize);
+			q->count++;
+		}
+	}
+	/* no slot used, take the message from a blocked sender directly. */
+	else if((thrd = q->sendQ_hdr) != NULL)
+	{
+		memcpy(msg, thrd->wait_data, q->slotSize);
+	}
+	/* empty, and not allowed to wait. */
+	else if(timeout == 0)
+	{
+		LEAVE_CRITICAL_SECTION;
+		return QUEUE_EMPTY;
+	}
+	/* empty, the sender will copy the message into "msg" directly. */
+	else
+	{
+		curThrd->wait_data = msg;
+		thrd_wait_prep(&q->recvQ_hdr, timeout);
+		LEAVE_CRITICAL_SECTION;
+		
+		/* call task dispatcher */
+		thread_dispatcher();
+		return curThrd->wait_rslt;
+	}
+	
+	/* wake up the sender whose message has been taken. */
+	if(thrd != NULL)
+		thrd_wait_done(thrd, 0);
+	LEAVE_CRITICAL_SECTION;
+	
+	if(thrd != NULL)
+		thread_dispatcher();
+	
+	return 0;
+}
+
+/** 
+ * @brief Get the number of the messages in the slots.
+ * \param q			The message queue.
+ */
+uint8_t
+msgq_count(msgq_t *q)
+{
+	return q->count;
+}
+
+/** 
+ * @brief Put a message into the queue, must be called with the interrupts disabled.
+ * \param q			The message queue.
+ * \param msg		Message to be sent.
+ * \param wakeup	Set to 1 if a waiting receiver is woken up.
+ * \return			0 if the message is queued, QUEUE_FULL otherwise.
+ */
+static uint8_t
+msgq_put(msgq_t *q, const void *msg, uint8_t *wakeup)
+{
+	thrd_tcb_t *thrd;
+	uint16_t tail;		/* "head + count" can exceed 255 with more than 128 slots. */
+	
+	/* a receiver is waiting, hand the message over to its buffer directly. */
+	thrd = q->recvQ_hdr;
+	if(thrd != NULL)
+	{
+		memcpy(thrd->wait_data, msg, q->slotSize);
+		thrd_wait_done(thrd, 0);
+		*wakeup = 1;
+		return 0;
+	}
+	
+	/* all the slots are used. */
+	if(q->count >= q->slotNum)
+		return QUEUE_FULL;
+	
+	/* copy into the tail slot. */
+	tail = q->head + q->count;
+	if(tail >= q->slotNum)
+		tail -= q->slotNum;
+	memcpy(MSGQ_SLOT(q, tail), msg, q->slotSize);
+	q->count++;
+	
+	return 0;
+}
+#endif	// RT_SUPPORT
@@ -0,0 +1,49 @@
+/**
+ * @file msgq.h
+ *
+ * @brief  header for msgq.c.
+ *
+ * @author	  Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _MSGQ_H_
+#define _MSGQ_H_
+
+/* === INCLUDES ============================================================ */
+#include "evt_driven_sched.h"
+#include "kernel.h"
+#include "semaphore.h"
+
+/* === TYPES =============================================================== */
+/** @brief 
+  * Message queue data structure.
+  * Messages are stored in fixed-size slots of a buffer supplied by the caller. */
+typedef struct {
+	uint8_t *buf;			/* slot buffer, "slotSize*slotNum" bytes. */
+	uint8_t slotSize;		/* size of each message. */
+	uint8_t slotNum;		/* number of slots, 0 for a pure hand-off queue. */
+	uint8_t head;			/* slot of the oldest message. */
+	uint8_t count;			/* number of messages in the slots. */
+	thrd_tcb_t* sendQ_hdr;	/* threads waiting for a free slot. */
+	thrd_tcb_t* recvQ_hdr;	/* threads waiting for a message. */
+} msgq_t;
+
+/* === MACROS ============================================================== */
+
+
+/* === GLOBALS ============================================================= */
+
+
+/* === PROTOTYPES ========================================================== */
+extern void msgq_init(msgq_t *q, void *buf, uint8_t slotSize, uint8_t slotNum);
+extern uint8_t msgq_send(msgq_t *q, const void *msg, uint16_t timeout);
+extern uint8_t msgq_post(msgq_t *q, const void *msg, uint8_t action);
+extern uint8_t msgq_recv(msgq_t *q, void *msg, uint16_t timeout);
+extern uint8_t msgq_count(msgq_t *q);
+
+
+#endif
+
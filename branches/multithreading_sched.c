@@ -19,6 +19,7 @@
 #include "kernel.h"
 #include "kdebug.h"
 #include "usart.h"
+#include "mem_quota.h"
 
 #if RT_SUPPORT
 /* === TYPES =============================================================== */
@@ -33,8 +34,14 @@
    the TCB in MIROS is pre-reserved other than dynamically allocated. */
 thrd_tcb_t thrd_TCB[MAX_THREAD_NUM], *thrd_lstQ= NULL;
 
-/* === PROTOTYPES ========================================================== */
+/* kernel timeout queue, to link all the threads blocked with a timeout.
+   It is a delta list: "tmo_ticks" of each thread is relative to the previous one,
+   thus only the queue header needs to be decremented on each timer tick. */
+thrd_tcb_t *thrd_tmoQ = NULL;
 
+/* === PROTOTYPES ========================================================== */
+static void thrd_tmo_add(thrd_tcb_t *thrd, uint16_t ticks);
+static void thrd_tmo_del(thrd_tcb_t *thrd);
 
 
 /* === IMPLEMENTATION ====================================================== */
@@ -93,9 +100,15 @@ thrd_contextPrep(tsk_handler_t thrd_tsk, uint16_t tsk_period)
 	thrd_TCB[id].thrd_sp = (uint8_t *)(heapSaddr - 1);
 	/* init the thread TCB. */
 	thrd_TCB[id].next = NULL;
+	thrd_TCB[id].semQ_next = NULL;
+	thrd_TCB[id].waitQ = NULL;
+	thrd_TCB[id].tmoQ_next = NULL;
 	thrd_TCB[id].thrd_tsk = thrd_tsk;
 	thrd_TCB[id].thrd_period = tsk_period;
 	thrd_TCB[id].status = THRD_ACTIVE;
+	#if MEM_QUOTA
+	mem_quota_init(&thrd_TCB[id]);
+	#endif
 	
 	/* add this thread into the thread queue in the order of the thread priority.
 	   thread with the smallest "thrd_period" (highest priority) will be put at the queue header. */
@@ -403,4 +416,164 @@ yield_Thread(thrd_tcb_t *thrd)
 	/* yield the control to the others. */
 	thread_dispatcher();
 }
+
+/**
+ * @brief Block the current thread on a wait queue, with an optional timeout.
+ * \param waitQ	Header of the wait queue, e.g. the semaphore queue.
+ * \param timeout	Maximum waiting time in ms, or WAIT_FOREVER.
+ *
+ * The current thread is added to the tail of "waitQ" and, if a timeout is given, 
+ * to the kernel timeout queue as well. Then it is set to "SUSPENDED".
+ * This is the common part of all the blocking primitives (semaphore, etc.):
+ * it must be called with the interrupts disabled, after that the caller
+ * calls "thread_dispatcher" and reads "curThrd->wait_rslt" once the thread is active again.
+ */
+void
+thrd_wait_prep(thrd_tcb_t **waitQ, uint16_t timeout)
+{
+	thrd_tcb_t *thrd;
+
+	/* add into the tail of the wait queue. */
+	curThrd->semQ_next = NULL;
+	if(*waitQ == NULL)
+		*waitQ = curThrd;
+	else
+	{
+		/* comes to the end */
+		for(thrd = *waitQ; thrd->semQ_next != NULL; thrd = thrd->semQ_next);
+		thrd->semQ_next = curThrd;
+	}
+	curThrd->waitQ = waitQ;
+	curThrd->wait_rslt = 0;
+
+	/* add into the kernel timeout queue. */
+	if(timeout != WAIT_FOREVER)
+		thrd_tmo_add(curThrd, MS_TO_TICKS(timeout));
+
+	/* set current thread to "SUSPENDED" status */
+	curThrd->status = THRD_SUSPENDED;
+}
+
+/**
+ * @brief Wake up a thread blocked by "thrd_wait_prep".
+ * \param thrd	The blocked thread.
+ * \param rslt	Result returned to the thread by its blocking call: 0, or TIMEOUT.
+ *
+ * Delete the thread from both its wait queue and the kernel timeout queue,
+ * thus the wait queue stays consistent whichever of them wakes it up first.
+ * Must be called with the interrupts disabled, the thread dispatcher is not called here.
+ */
+void
+thrd_wait_done(thrd_tcb_t *thrd, uint8_t rslt)
+{
+	thrd_tcb_t *t, *prev;
+
+	/* delete from the wait queue. */
+	if(thrd->waitQ != NULL)
+	{
+		for(prev = NULL, t = *thrd->waitQ; t != NULL; prev = t, t = t->semQ_next)
+		{
+			if(t == thrd)
+			{
+				if(prev == NULL)
+					*thrd->waitQ = thrd->semQ_next;
+				else
+					prev->semQ_next = thrd->semQ_next;
+				break;
+			}
+		}
+		thrd->waitQ = NULL;
+	}
+	thrd->semQ_next = NULL;
+
+	/* delete from the timeout queue. */
+	thrd_tmo_del(thrd);
+
+	thrd->wait_rslt = rslt;
+	thrd->status = THRD_ACTIVE;
+}
+
+/**
+ * @brief Kernel timeout service, called on every hardware timer tick.
+ *
+ * Decrement the header of the timeout queue, and wake up all the threads 
+ * whose timeout is expired with the result TIMEOUT.
+ * If any thread is woken up, force the thread switch.
+ */
+void
+thrd_tmoService(void)
+{
+	uint8_t wakeup = 0;
+
+	if(thrd_tmoQ == NULL)	return;
+
+	/* the following threads are relative to the header, only decrement it. */
+	if(thrd_tmoQ->tmo_ticks > 0)
+		thrd_tmoQ->tmo_ticks--;
+
+	/* wake up all the expired threads. */
+	while((thrd_tmoQ != NULL) && (thrd_tmoQ->tmo_ticks == 0))
+	{
+		thrd_wait_done(thrd_tmoQ, TIMEOUT);
+		wakeup = 1;
+	}
+
+	if(wakeup)
+		thread_dispatcher();
+}
+
+/**
+ * @brief Insert a thread into the kernel timeout queue.
+ * \param thrd	The thread to be inserted.
+ * \param ticks	Timeout in timer ticks.
+ */
+static void
+thrd_tmo_add(thrd_tcb_t *thrd, uint16_t ticks)
+{
+	thrd_tcb_t *t, *prev = NULL;
+
+	/* locate the position, converting "ticks" to be relative to the previous thread. */
+	for(t = thrd_tmoQ; (t != NULL) && (ticks >= t->tmo_ticks); t = t->tmoQ_next)
+	{
+		ticks -= t->tmo_ticks;
+		prev = t;
+	}
+
+	/* insert "thrd" in front of "t", the next one becomes relative to "thrd". */
+	thrd->tmo_ticks = ticks;
+	thrd->tmoQ_next = t;
+	if(t != NULL)
+		t->tmo_ticks -= ticks;
+	if(prev == NULL)
+		thrd_tmoQ = thrd;
+	else
+		prev->tmoQ_next = thrd;
+}
+
+/**
+ * @brief Delete a thread from the kernel timeout queue, if it is inside.
+ * \param thrd	The thread to be deleted.
+ */
+static void
+thrd_tmo_del(thrd_tcb_t *thrd)
+{
+	thrd_tcb_t *t, *prev = NULL;
+
+	for(t = thrd_tmoQ; t != NULL; t = t->tmoQ_next)
+	{
+		if(t == thrd)
+		{
+			/* give the remaining ticks to the next one. */
+			if(thrd->tmoQ_next != NULL)
+				thrd->tmoQ_next->tmo_ticks += thrd->tmo_ticks;
+			if(prev == NULL)
+				thrd_tmoQ = thrd->tmoQ_next;
+			else
+				prev->tmoQ_next = thrd->tmoQ_next;
+			thrd->tmoQ_next = NULL;
+			return;
+		}
+		prev = t;
+	}
+}
 #endif	// RT_SUPPORT
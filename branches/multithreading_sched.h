@@ -33,8 +33,19 @@ __ALIGNED2 typedef struct thrd_tcb
 	uint8_t *thrd_sp;			/* stack's run-time address. */
 	tsk_handler_t thrd_tsk;	/* pointer to the task executed by this thread. */
 	struct thrd_tcb *semQ_next;	/* queue for the resource semaphore. */
+	struct thrd_tcb **waitQ;	/* header of the wait queue this thread is blocked on, NULL if not blocked. */
+	struct thrd_tcb *tmoQ_next;	/* queue for the kernel timeout. */
+	uint16_t tmo_ticks;			/* timeout ticks, relative to the previous thread in the timeout queue. */
 	uint16_t thrd_period;		/* period of the task, will determine the priority of this thread. */
 	uint8_t status;				/* "UNUSED, SUSPENDED, ACTIVE, etc." */
+	uint8_t wait_rslt;			/* result of the last blocking wait: 0, or TIMEOUT. */
+	uint8_t wait_opt;			/* wait option of the blocking primitive, e.g. event group ANY/ALL. */
+	uint16_t wait_arg;			/* wait argument of the blocking primitive, e.g. event group flags. */
+	void *wait_data;			/* data handed over by the blocking primitive, e.g. message queue buffer. */
+	#if MEM_QUOTA
+	uint16_t mem_quota;			/* bytes this thread may hold in the heap. */
+	uint16_t mem_used;			/* bytes held in the heap by this thread. */
+	#endif
 	#if KDEBUG_DEMO
 	uint8_t thrd_id;			/* used for demo. */
 	#endif
@@ -45,6 +56,11 @@ __ALIGNED2 typedef struct thrd_tcb
 #define MAX_THREAD_NUM		8
 #define	THREAD_CONTEXT_SIZE	128
 
+/* timeout for the blocking operations: wait until the resource is posted. */
+#define WAIT_FOREVER		0xFFFF
+/* convert a timeout in ms to the kernel timeout ticks (rounded up). */
+#define MS_TO_TICKS(ms)		((uint16_t)(((uint32_t)(ms) + APPTIMERINTERVAL - 1) / APPTIMERINTERVAL))
+
 
 /* === GLOBALS ============================================================= */
 extern thrd_tcb_t *thrd_lstQ;
@@ -60,5 +76,8 @@ extern void thrdContextSave(void);
 extern void thrdContextRestore(void);
 extern void active_Thread(thrd_tcb_t *thrd);
 extern void yield_Thread(thrd_tcb_t *thrd);
+extern void thrd_wait_prep(thrd_tcb_t **waitQ, uint16_t timeout);
+extern void thrd_wait_done(thrd_tcb_t *thrd, uint8_t rslt);
+extern void thrd_tmoService(void);
 
 #endif
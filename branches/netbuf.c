@@ -0,0 +1,115 @@
+/**
+ * @file netbuf.c
+ * 
+ * @brief	Pool of fixed-size, reference-counted network buffers.
+ *			A buffer can be queued to several IPC ports without copying the data: 
+ *			each queued message holds one reference, and releases it after the message has been sent out.
+ *			The buffer goes back to the pool when the last reference is released.
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* === INCLUDES ============================================================ */
+#include "typedef.h"
+#include "board.h"
+#include "kdebug.h"
+#include "netbuf.h"
+
+/* === TYPES =============================================================== */
+
+
+/* === MACROS ============================================================== */
+
+
+/* === GLOBALS ============================================================= */
+/* buffers are pre-reserved, the same as the thread TCBs. */
+netbuf_t netbuf_pool[NETBUF_NUM];
+
+/* free buffers in the pool. */
+netbuf_t *netbuf_freeQ = NULL;
+
+
+/* === PROTOTYPES ========================================================== */
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Initialization of the network buffer pool.
+ *
+ *	Link all the buffers to the free list.
+ */
+void
+netbuf_init(void)
+{
+	uint8_t i;
+	
+	netbuf_freeQ = NULL;
+	for(i = 0; i < NETBUF_NUM; i++)
+	{
+		netbuf_pool[i].ref = 0;
+		netbuf_pool[i].next = netbuf_freeQ;
+		netbuf_freeQ = &netbuf_pool[i];
+	}
+}
+
+/**
+ * @brief Allocate a buffer from the pool.
+ *
+ * \return		The buffer with one reference held by the caller, NULL if the pool is empty.
+ */
+netbuf_t*
+netbuf_alloc(void)
+{
+	HAS_CRITICAL_SECTION;
+	netbuf_t *buf;
+	
+	ENTER_CRITICAL_SECTION;
+	buf = netbuf_freeQ;
+	if(buf != NULL)
+	{
+		netbuf_freeQ = buf->next;
+		buf->next = NULL;
+		buf->ref = 1;
+		buf->len = 0;
+	}
+	LEAVE_CRITICAL_SECTION;
+	
+	return buf;
+}
+
+/**
+ * @brief Take one more reference to a buffer.
+ * \param buf	The buffer.
+ */
+void
+netbuf_ref(netbuf_t *buf)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	buf->ref++;
+	LEAVE_CRITICAL_SECTION;
+}
+
+/**
+ * @brief Release one reference to a buffer.
+ * \param buf	The buffer.
+ *
+ *	The buffer goes back to the pool when the last reference is released.
+ *	It can be called from the ISR, e.g. after a message has been sent out.
+ */
+void
+netbuf_free(netbuf_t *buf)
+{
+	HAS_CRITICAL_SECTION;
+	
+	ENTER_CRITICAL_SECTION;
+	if((buf->ref != 0) && (--buf->ref == 0))
+	{
+		buf->next = netbuf_freeQ;
+		netbuf_freeQ = buf;
+	}
+	LEAVE_CRITICAL_SECTION;
+}
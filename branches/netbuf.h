@@ -0,0 +1,46 @@
+/**
+ * @file netbuf.h
+ *
+ * @brief  header for netbuf.c
+ *
+ * @author    Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _NETBUF_H_
+#define _NETBUF_H_ 
+ 
+/* === Includes ============================================================= */
+#include "board.h"
+
+
+/* === Macros =============================================================== */
+/* number of buffers in the pool. */
+#define NETBUF_NUM		4
+/* data size of each buffer, large enough for a "sensingPkt_t". */
+#define NETBUF_SIZE		64
+
+
+/* === Types ================================================================ */
+/* network buffer, shared by reference counting. */
+__ALIGNED2 typedef struct netbuf
+{
+	struct netbuf *next;		/* link to the next free buffer in the pool. */
+	uint8_t ref;				/* reference counter, 0 if the buffer is in the pool. */
+	uint8_t len;				/* length of the valid data. */
+	uint8_t data[NETBUF_SIZE];
+} netbuf_t;
+
+
+/* === GLOBALS ============================================================= */
+
+
+/* === Prototypes =========================================================== */
+extern void netbuf_init(void);
+extern netbuf_t* netbuf_alloc(void);
+extern void netbuf_ref(netbuf_t *buf);
+extern void netbuf_free(netbuf_t *buf);
+
+#endif
@@ -24,6 +24,10 @@
 #include "mem_reactive_SF.h"
 #include "mem_SFL.h"
 #include "mem_SFL_extHeap.h"
+#include "mem_TLSF.h"
+#include "mem_ref.h"
+#include "mem_quota.h"
+#include "netbuf.h"
 #include "avr/delay.h"
 
 
@@ -72,7 +76,9 @@ uint16_t *t1, *t2, *t3;
 /* === IMPLEMENTATION ====================================================== */
 /**
  * @brief Main entry function
+ *	The host tools (IPC benchmark, allocator replay) have their own.
  */
+#if !IPC_BENCH_HOST && !MEM_TRACE_HOST
 int
 main(void)
 {
@@ -164,6 +170,7 @@ main(void)
 		event_driven_scheduling();
 	}
 }
+#endif
  
 
 /**
@@ -185,6 +192,9 @@ software_init(void)
 	#if KDEBUG_DEMO
 	curThrd->thrd_id = 1;
 	#endif
+	#if MEM_QUOTA
+	mem_quota_init(curThrd);
+	#endif
 	
 	/* thread stacks starting memory address.
 	   The symbol "_sys_data_end" is defined in the link script,
@@ -202,22 +212,26 @@ software_init(void)
 	
 	/* init the "hpFreeQ" and "reSF_freeQ" for MIROS memory allocator. */
 	mem_init();
+	
+	/* init the network buffer pool used by the IPC. */
+	netbuf_init();
+	
+	/* register the built-in IPC ports. */
+	ipc_init();
 }
 
 /**
  * @brief Initialization of MIROS allocator.
  *
- *	This function is used to initialize the "hpFreeQ" or "reSF_freeQ" in MIROS memory allocation. 
+ *	This function is used to initialize the "hpFreeQ", "reSF_freeQ" or the TLSF free lists in MIROS memory allocation. 
  */
 void
 mem_init(void)
 {
 	/* for MIROS SFL allocator. */
 	#if MEM_SFL
-		/* initialize hpFreeQ in SFL allocator. */
-		hpFreeQ = (sfl_extHpHdr_t *)heapSaddr;
-		hpFreeQ->ckSize = HEAP_EADDR - (uint16_t)heapSaddr;
-		hpFreeQ->next = hpFreeQ->prev = (sfl_extHpHdr_t *)heapSaddr;
+		/* initialize the extended heap "hpFreeQ" in SFL allocator. */
+		memSFL_extHeap_init(heapSaddr, HEAP_EADDR - (uintptr_t)heapSaddr);
 		/* init the partitions. */
 		mem_init_partitions();
 	#endif
@@ -226,7 +240,7 @@ mem_init(void)
 	#if MEM_REACTIVE_SF
 		/* init the free heap. */
 		reSF_freeQ = (reSF_chk_hdr_t *)heapSaddr;
-		reSF_freeQ->ckSize = HEAP_EADDR - (uint16_t)heapSaddr;
+		reSF_freeQ->ckSize = HEAP_EADDR - (uintptr_t)heapSaddr;
 		
 		#if KDEBUG_DEMO	// used for debug demo, set to 112 bytes (8 bytes for each unit).
 		reSF_freeQ->ckSize = 112;
@@ -238,19 +252,22 @@ mem_init(void)
 		
 		reSF_freeQ->next = reSF_freeQ->prev = (reSF_chk_hdr_t *)heapSaddr;
 		reSF_freeQ->ckRef = NULL;
+		reSF_hpEaddr = (void *)((uintptr_t)heapSaddr + reSF_freeQ->ckSize);
 		/* init all the references */
-		uint8_t i;
-		for(i = 0; i < REF_NUM; i++)
-			reSF_Ref[i] = 0;
+		memRef_init();
 	#endif
 	
 	/* for MIROS proactive SF allocator. */
 	#if MEM_PROACTIVE_SF
 		leftHpSaddr = heapSaddr;
+		proSF_hpEaddr = (void *)HEAP_EADDR;
 		/* init all the references */
-		uint8_t i;
-		for(i = 0; i < REF_NUM; i++)
-			proSF_Ref[i] = 0;
+		memRef_init();
+	#endif
+	
+	/* for MIROS TLSF allocator. */
+	#if MEM_TLSF
+		memTLSF_init(heapSaddr, HEAP_EADDR - (uintptr_t)heapSaddr);
 	#endif
 }
 
@@ -262,8 +279,7 @@ mem_init_partitions(void)
 {
 	/* init all the created partitions here. */
 	#if MEM_SFL
-	memSFL_partition_init(&timer_pt);
-	memSFL_partition_init(&ipc_pt);
+	memSFL_init();
 	#endif
 }
 
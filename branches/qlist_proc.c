@@ -88,7 +88,7 @@ void
 dlst_merge(dlist **Qhead, dlist *listA, dlist *listB)
 {
 	/* merge listB into listA, and then delete listB. */
-	if(((uint16_t)listA + listA->size) == (uint16_t)listB)	{
+	if(((uintptr_t)listA + listA->size) == (uintptr_t)listB)	{
 		/* delete "listB" */
 		dlst_del(Qhead, (dlist *)listB);
 		/* update "listA" size */
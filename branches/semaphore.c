@@ -2,6 +2,8 @@
  * @file semaphore.c
  *
  * @brief  semaphore to access the shared resources among the threads. 
+ *
+ *			Condition variables are bound to a semaphore used as mutex.
  *
  * @author	  Xing Liu  (http://edss.isima.fr/sites/smir/)
  * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
@@ -49,7 +51,9 @@ sem_init(semaphore_t *s, int value)
  * \param s			The semaphore to be posted to the others.
  * \param action	Whether force the thread switch after this semaphore is posted.
  *
- * Increment the internal value of the semaphore,
+ * If a thread is waiting for this semaphore, the unit is handed over to it directly,
+ * and it is deleted from both the semaphore queue and the kernel timeout queue.
+ * Otherwise, increment the internal value of the semaphore.
  */
 uint8_t
 sem_post(semaphore_t *s, uint8_t action)
@@ -58,46 +62,55 @@ sem_post(semaphore_t *s, uint8_t action)
 	thrd_tcb_t *thrd;
 	
 	ENTER_CRITICAL_SECTION;
-	/* Post a unit and wake-up the next waiting thread. */
-	s->val++;
-
 	/* get the next task that is waiting for this resource. */
 	thrd = s->semQ_hdr;
-	/* set this thread's status to "ACTIVE". */
-	if(thrd != NULL)
+	
+	/* no thread is waiting, keep the unit in the semaphore. */
+	if(thrd == NULL)
 	{
-		/* delete this thread from the semaphore queue */
-		s->semQ_hdr = thrd->semQ_next;
-		
-		/* update this task's status */
-		if(thrd->status == THRD_SUSPENDED)
-		{
-			thrd->status = THRD_ACTIVE;
-			LEAVE_CRITICAL_SECTION;
-			
-			/* force the thread dispatcher now if it is required. */
-			if(action == DISPATCHER)
-				thread_dispatcher();
-		}
+		s->val++;
+		LEAVE_CRITICAL_SECTION;
+		return 0;
 	}
+	
+	/* hand the unit over to this thread, and set its status to "ACTIVE". */
+	thrd_wait_done(thrd, 0);
 	LEAVE_CRITICAL_SECTION;
 	
+	/* force the thread dispatcher now if it is required. */
+	if(action == DISPATCHER)
+		thread_dispatcher();
+	
 	return 0;
 }
 
 /** 
  * @brief Wait on a semaphore.
  * \param s		Try to get this semaphore.
- * \return		Return the acquiring status, SUCCESS if acquire the semaphore successfully.
+ * \return		Return the acquiring status, 0 if acquire the semaphore successfully.
  *
  * If the semaphore internal value is non-zero, get this resource and decrements the semaphore value.  
  * If the value is zero, then enter the waiting queue and dispatcher the thread.
  */
 uint8_t
 sem_acquire(semaphore_t *s)
+{
+	return sem_acquire_timeout(s, WAIT_FOREVER);
+}
+
+/** 
+ * @brief Wait on a semaphore, for a limited time.
+ * \param s			Try to get this semaphore.
+ * \param timeout	Maximum waiting time in ms, 0 to not wait, or WAIT_FOREVER.
+ * \return			0 if acquire the semaphore successfully, TIMEOUT if not posted in time.
+ *
+ * If the value is zero, the thread enters both the semaphore queue and the kernel timeout queue.
+ * It is deleted from both of them by whichever comes first, "sem_post" or the timeout.
+ */
+uint8_t
+sem_acquire_timeout(semaphore_t *s, uint16_t timeout)
 {
 	HAS_CRITICAL_SECTION;
-	thrd_tcb_t *thrd;
 	
 	ENTER_CRITICAL_SECTION;
 	/* if val is higher than or equal to 1,
@@ -106,28 +119,135 @@ sem_acquire(semaphore_t *s)
 	{
 		s->val--;
 		LEAVE_CRITICAL_SECTION;
-		return ERROR;
-	}	
-	/* If no resources are available then we wait in the queue */
-	else {
-		/* add into the semaphore queue */
-		if(s->semQ_hdr == NULL)
-			s->semQ_hdr = curThrd;
-		else
-		{
-			/* comes to the end */
-			for(thrd = s->semQ_hdr; thrd->semQ_next == NULL; thrd = thrd->semQ_next);
-			/* add this thread into the queue */
-			thrd->semQ_next = curThrd;
-		}
-		/* set current thread to "SUSPENDED" status */
-		curThrd->status = THRD_SUSPENDED;
+		return 0;
+	}
+	
+	/* not available, and not allowed to wait. */
+	if(timeout == 0)
+	{
 		LEAVE_CRITICAL_SECTION;
+		return TIMEOUT;
+	}
+	
+	/* If no resources are available then we wait in the queue */
+	thrd_wait_prep(&s->semQ_hdr, timeout);
+	LEAVE_CRITICAL_SECTION;
+
+	/* call task dispatcher */
+	thread_dispatcher();
+	
+	/* active again: the unit has been handed over by "sem_post", or timeout. */
+	return curThrd->wait_rslt;
+}
+
+/**
+ * @brief Function to initialize the condition variable.
+ * \param cv		Pointer to a condition variable structure.
+ */
+void 
+cond_init(cond_t *cv)
+{
+	cv->condQ_hdr = NULL;
+}
+
+/** 
+ * @brief Wait on a condition variable.
+ * \param cv		The condition variable.
+ * \param mutex		The mutex protecting the predicate, held by the caller.
+ * \return			0 when signaled.
+ *
+ * Release the mutex and wait for the signal, the mutex is acquired again before return.
+ * The caller should check its predicate again in a loop.
+ */
+uint8_t
+cond_wait(cond_t *cv, semaphore_t *mutex)
+{
+	return cond_wait_timeout(cv, mutex, WAIT_FOREVER);
+}
 
-		/* call task dispatcher */
+/** 
+ * @brief Wait on a condition variable, for a limited time.
+ * \param cv		The condition variable.
+ * \param mutex		The mutex protecting the predicate, held by the caller.
+ * \param timeout	Maximum waiting time in ms, or WAIT_FOREVER.
+ * \return			0 when signaled, TIMEOUT if not signaled in time.
+ *
+ * The thread enters the condition queue before the mutex is released, 
+ * with the interrupts disabled, thus no signal can be lost in between.
+ * The mutex is acquired again before return, also on timeout.
+ * With a timeout of 0, TIMEOUT is returned at once, and the mutex is not released.
+ */
+uint8_t
+cond_wait_timeout(cond_t *cv, semaphore_t *mutex, uint16_t timeout)
+{
+	HAS_CRITICAL_SECTION;
+	uint8_t rslt;
+	
+	/* not allowed to wait, the mutex is kept. */
+	if(timeout == 0)
+		return TIMEOUT;
+	
+	ENTER_CRITICAL_SECTION;
+	/* enter the condition queue, and then release the mutex. */
+	thrd_wait_prep(&cv->condQ_hdr, timeout);
+	sem_post(mutex, NO_DISPATCHER);
+	LEAVE_CRITICAL_SECTION;
+	
+	/* call task dispatcher */
+	thread_dispatcher();
+	rslt = curThrd->wait_rslt;
+	
+	/* reacquire the mutex. */
+	sem_acquire(mutex);
+	
+	return rslt;
+}
+
+/** 
+ * @brief Wake up the first thread waiting on the condition variable.
+ * \param cv		The condition variable.
+ * \param action	Whether force the thread switch if a thread is woken up.
+ */
+void
+cond_signal(cond_t *cv, uint8_t action)
+{
+	HAS_CRITICAL_SECTION;
+	thrd_tcb_t *thrd;
+	
+	ENTER_CRITICAL_SECTION;
+	thrd = cv->condQ_hdr;
+	if(thrd != NULL)
+		thrd_wait_done(thrd, 0);
+	LEAVE_CRITICAL_SECTION;
+	
+	/* force the thread dispatcher now if it is required. */
+	if((thrd != NULL) && (action == DISPATCHER))
 		thread_dispatcher();
+}
+
+/** 
+ * @brief Wake up all the threads waiting on the condition variable.
+ * \param cv		The condition variable.
+ * \param action	Whether force the thread switch if any thread is woken up.
+ *
+ * The threads are all set to "ACTIVE" first, then only one thread dispatch is done.
+ */
+void
+cond_broadcast(cond_t *cv, uint8_t action)
+{
+	HAS_CRITICAL_SECTION;
+	uint8_t wakeup = 0;
+	
+	ENTER_CRITICAL_SECTION;
+	while(cv->condQ_hdr != NULL)
+	{
+		thrd_wait_done(cv->condQ_hdr, 0);
+		wakeup = 1;
 	}
+	LEAVE_CRITICAL_SECTION;
 	
-	return 0;
+	/* force the thread dispatcher now if it is required. */
+	if(wakeup && (action == DISPATCHER))
+		thread_dispatcher();
 }
 #endif	// RT_SUPPORT
\ No newline at end of file
@@ -24,6 +24,13 @@ typedef struct {
 	thrd_tcb_t* semQ_hdr;
 } semaphore_t;
 
+/** @brief 
+  * Condition variable data structure.
+  * A semaphore initialized to 1 is used as the mutex protecting the shared state. */
+typedef struct {
+	thrd_tcb_t* condQ_hdr;
+} cond_t;
+
 /** @brief 
    * whether dispatch the tasks after the semaphore resource is released. */
 typedef enum sem_action
@@ -39,6 +46,15 @@ typedef enum sem_action
 
 
 /* === PROTOTYPES ========================================================== */
+extern void sem_init(semaphore_t *s, int value);
+extern uint8_t sem_post(semaphore_t *s, uint8_t action);
+extern uint8_t sem_acquire(semaphore_t *s);
+extern uint8_t sem_acquire_timeout(semaphore_t *s, uint16_t timeout);
+extern void cond_init(cond_t *cv);
+extern uint8_t cond_wait(cond_t *cv, semaphore_t *mutex);
+extern uint8_t cond_wait_timeout(cond_t *cv, semaphore_t *mutex, uint16_t timeout);
+extern void cond_signal(cond_t *cv, uint8_t action);
+extern void cond_broadcast(cond_t *cv, uint8_t action);
 
 
 /* === IMPLEMENTATION ====================================================== */
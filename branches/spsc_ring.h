@@ -0,0 +1,204 @@
+/**
+ * @file spsc_ring.h
+ *
+ * @brief  lock-free single-producer/single-consumer ring buffer.
+ *
+ *			Used to stream the data from an ISR to a task (or the reverse) without disabling the interrupts.
+ *			The producer only writes "head", the consumer only writes "tail". Both are 8-bit free-running indexes,
+ *			their stores are atomic on AVR, thus "push" and "pop" are wait-free.
+ *			The capacity must be a power of two and at most 128 elements.
+ *
+ * @author	  Xing Liu  (http://edss.isima.fr/sites/smir/)
+ * @author    LIMOS Laboratory - UMR CNRS 6158: http://edss.isima.fr
+ * @author    Supported email: liu@isima.fr
+ */
+
+/* Prevent double inclusion */
+#ifndef _SPSC_RING_H_
+#define _SPSC_RING_H_
+
+/* === INCLUDES ============================================================ */
+#include "board.h"
+#include "typedef.h"
+
+/* === TYPES =============================================================== */
+/* ring buffer header. */
+typedef struct spsc_ring
+{
+	volatile uint8_t head;		/* free-running write index, written by the producer only. */
+	volatile uint8_t tail;		/* free-running read index, written by the consumer only. */
+	uint8_t mask;				/* capacity - 1. */
+	uint8_t elemSize;			/* size of each element. */
+	uint8_t *buf;				/* element storage, "elemSize*(mask+1)" bytes. */
+} spsc_ring_t;
+
+/* === MACROS ============================================================== */
+#ifndef CC_CONCAT
+#define CC_CONCAT2(s1, s2) s1##s2
+#define CC_CONCAT(s1, s2) CC_CONCAT2(s1, s2)
+#endif
+
+/* compiler barrier, the element copy must complete before the index is published. */
+#define SPSC_BARRIER()		asm volatile("" ::: "memory")
+
+/*
+ * This macro is used to create a new ring buffer.
+ *
+ * \param name 
+ *		The name of this ring, the header will be "name_ring".
+ * \param type 
+ *		The type of the elements.
+ * \param size
+ *		Number of elements, must be a power of two, from 1 to 128.
+ */
+#define SPSC_RING_CREATE(name, type, size) \
+	typedef char CC_CONCAT(name,_ring_size_check)[((size) != 0 && ((size) & ((size) - 1)) == 0 && (size) <= 128) ? 1 : -1]; \
+	uint8_t CC_CONCAT(name,_rbuf)[sizeof(type)*(size)]; \
+	spsc_ring_t CC_CONCAT(name,_ring) = { \
+		0, \
+		0, \
+		(size) - 1, \
+		sizeof(type), \
+		CC_CONCAT(name,_rbuf)}
+
+
+/* === PROTOTYPES ========================================================== */
+
+
+/* === IMPLEMENTATION ====================================================== */
+/**
+ * @brief Number of elements in the ring.
+ */
+INLINE uint8_t
+spsc_count(spsc_ring_t *r)
+{
+	return (uint8_t)(r->head - r->tail);
+}
+
+/**
+ * @brief Number of free elements in the ring.
+ */
+INLINE uint8_t
+spsc_space(spsc_ring_t *r)
+{
+	return (uint8_t)(r->mask + 1 - (uint8_t)(r->head - r->tail));
+}
+
+/**
+ * @brief Copy "n" elements into the ring from index "idx", wrapping at the end of the buffer.
+ */
+INLINE void
+spsc_copy_in(spsc_ring_t *r, uint8_t idx, const uint8_t *src, uint8_t n)
+{
+	uint8_t *to = r->buf + (uint16_t)(idx & r->mask) * r->elemSize;
+	uint16_t len = (uint16_t)n * r->elemSize;
+	uint16_t room = (uint16_t)(r->mask + 1 - (idx & r->mask)) * r->elemSize;
+
+	if(len > room)
+	{
+		/* two segments: up to the end of the buffer, then from the beginning. */
+		for(; room != 0; room--, len--)	*to++ = *src++;
+		to = r->buf;
+	}
+	for(; len != 0; len--)	*to++ = *src++;
+}
+
+/**
+ * @brief Copy "n" elements out of the ring from index "idx", wrapping at the end of the buffer.
+ */
+INLINE void
+spsc_copy_out(spsc_ring_t *r, uint8_t idx, uint8_t *dst, uint8_t n)
+{
+	const uint8_t *from = r->buf + (uint16_t)(idx & r->mask) * r->elemSize;
+	uint16_t len = (uint16_t)n * r->elemSize;
+	uint16_t room = (uint16_t)(r->mask + 1 - (idx & r->mask)) * r->elemSize;
+
+	if(len > room)
+	{
+		/* two segments: up to the end of the buffer, then from the beginning. */
+		for(; room != 0; room--, len--)	*dst++ = *from++;
+		from = r->buf;
+	}
+	for(; len != 0; len--)	*dst++ = *from++;
+}
+
+/**
+ * @brief Push one element, called by the producer only.
+ * \param r		The ring.
+ * \param e		Element to be pushed.
+ * \return		true if pushed, false if the ring is full.
+ */
+INLINE bool
+spsc_push(spsc_ring_t *r, const void *e)
+{
+	uint8_t head = r->head;
+
+	if((uint8_t)(head - r->tail) > r->mask)	return false;
+	spsc_copy_in(r, head, e, 1);
+	SPSC_BARRIER();
+	r->head = head + 1;
+	return true;
+}
+
+/**
+ * @brief Pop one element, called by the consumer only.
+ * \param r		The ring.
+ * \param e		Buffer for the element.
+ * \return		true if popped, false if the ring is empty.
+ */
+INLINE bool
+spsc_pop(spsc_ring_t *r, void *e)
+{
+	uint8_t tail = r->tail;
+
+	if(r->head == tail)	return false;
+	spsc_copy_out(r, tail, e, 1);
+	SPSC_BARRIER();
+	r->tail = tail + 1;
+	return true;
+}
+
+/**
+ * @brief Push up to "n" elements in one burst, called by the producer only.
+ * \param r		The ring.
+ * \param src	Elements to be pushed.
+ * \param n		Number of elements.
+ * \return		Number of elements pushed, limited by the free space.
+ */
+INLINE uint8_t
+spsc_push_n(spsc_ring_t *r, const void *src, uint8_t n)
+{
+	uint8_t head = r->head;
+	uint8_t space = (uint8_t)(r->mask + 1 - (uint8_t)(head - r->tail));
+
+	if(n > space)	n = space;
+	if(n == 0)	return 0;
+	spsc_copy_in(r, head, src, n);
+	SPSC_BARRIER();
+	r->head = head + n;
+	return n;
+}
+
+/**
+ * @brief Pop up to "n" elements in one burst, called by the consumer only.
+ * \param r		The ring.
+ * \param dst	Buffer for the elements.
+ * \param n		Maximum number of elements.
+ * \return		Number of elements popped.
+ */
+INLINE uint8_t
+spsc_pop_n(spsc_ring_t *r, void *dst, uint8_t n)
+{
+	uint8_t tail = r->tail;
+	uint8_t count = (uint8_t)(r->head - tail);
+
+	if(n > count)	n = count;
+	if(n == 0)	return 0;
+	spsc_copy_out(r, tail, dst, n);
+	SPSC_BARRIER();
+	r->tail = tail + n;
+	return n;
+}
+
+#endif
+
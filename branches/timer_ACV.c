@@ -48,6 +48,10 @@ ISR(TIMER4_COMPA_vect)
 	sysAbsTime += APPTIMERINTERVAL;
 	/* SysTimer Service. */
 	timerService();
+	#if RT_SUPPORT
+	/* timeout of the blocked threads. */
+	thrd_tmoService();
+	#endif
 }
 
 /**
@@ -48,6 +48,10 @@ ISR(TIMER4_COMPA_vect)
 	ENTER_CRITICAL_SECTION;	
 	/* SysTimer Service. */
 	timerService();
+	#if RT_SUPPORT
+	/* timeout of the blocked threads. */
+	thrd_tmoService();
+	#endif
 	LEAVE_CRITICAL_SECTION;
 }
 